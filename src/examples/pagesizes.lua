@@ -0,0 +1,83 @@
+-- reports write, read and iterate throughput across page sizes
+-- usage: luajit pagesizes.lua [count] [key length] [data length]
+-- every page size runs in its own process and storage directory since a
+-- storage keeps the page sizes it was created with
+require "packages"
+require "spaces"
+
+local sizes = {16, 32, 64, 96, 128}
+local u = tonumber(arg[1]) or 1e6
+local kl = tonumber(arg[2]) or 16
+local dl = tonumber(arg[3]) or 64
+local seed = 78976
+
+local charset = {}  do -- [0-9a-zA-Z]
+	for c = 48, 57  do table.insert(charset, string.char(c)) end
+	for c = 65, 90  do table.insert(charset, string.char(c)) end
+	for c = 97, 122 do table.insert(charset, string.char(c)) end
+end
+
+local function randomString(length)
+	if not length or length <= 0 then return '' end
+	return randomString(length - 1) .. charset[math.random(1, #charset)]
+end
+
+local function generate(n)
+	math.randomseed(seed)
+	local tdata = {}
+	for ri = 1,n do
+		tdata[ri] = randomString(kl)
+	end
+	return tdata
+end
+
+local function run(size)
+	spaces.storage("pagesizes_"..size)
+	spaces.pageSizes(size)
+	local s = spaces.open()
+	s.data = {}
+	local data = s.data
+	local tdata = generate(u)
+	local value = randomString(dl)
+
+	local t = os.clock()
+	for i = 1,u do
+		data[tdata[i]] = value
+	end
+	spaces.commit()
+	local wt = os.clock() - t
+
+	spaces.read()
+	t = os.clock()
+	local missed = 0
+	for i = 1,u do
+		if data[tdata[i]] == nil then
+			missed = missed + 1
+		end
+	end
+	local rt = os.clock() - t
+
+	t = os.clock()
+	local cnt = 0
+	for k,v in pairs(data) do
+		cnt = cnt + 1
+	end
+	local it = os.clock() - t
+	spaces.commit()
+	if missed > 0 then
+		error("missing "..missed.." keys")
+	end
+	print(string.format("%6d %12d %12d %12d", size, math.floor(u/wt), math.floor(u/rt), math.floor(cnt/it)))
+end
+
+if arg[4] then
+	run(tonumber(arg[4]))
+else
+	print("keys: "..u, "key l.: "..kl, "data l.: "..dl)
+	print(string.format("%6s %12s %12s %12s", "slots", "writes/s", "reads/s", "iterated/s"))
+	for _,size in ipairs(sizes) do
+		local p = io.popen(string.format("%s %s %d %d %d %d", arg[-1], arg[0], u, kl, dl, size))
+		io.write(p:read("*a"))
+		p:close()
+	end
+end
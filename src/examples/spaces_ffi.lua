@@ -0,0 +1,125 @@
+-- reads and writes spaces through the flat C functions in spaces_ffi.h with
+-- the LuaJIT ffi, so that loops over a space compile into traces instead of
+-- calling the meta methods each time
+-- usage:
+--   local sffi = require "spaces_ffi"
+--   local s = spaces.open()
+--   local f = sffi.wrap(s)
+--   f:put("k", 1)
+--   print(f:get("k"))
+--   for k,v in f:pairs() do print(k,v) end
+-- only text, numbers and booleans are read and written, tables are read as
+-- wrapped spaces and everything else is nil. pairs should not write to the
+-- space it iterates, like pairs on a space
+require "spaces"
+local ffi = require "ffi"
+
+ffi.cdef[[
+typedef struct spaces_ffi_value {
+	int type;
+	const char* bytes;
+	size_t size;
+	double number;
+	uint64_t identity;
+} spaces_ffi_value;
+typedef struct spaces_ffi_cursor spaces_ffi_cursor;
+int spaces_ffi_get(void* session, uint64_t context, const spaces_ffi_value* name, spaces_ffi_value* value);
+int spaces_ffi_put(void* session, uint64_t context, const spaces_ffi_value* name, const spaces_ffi_value* value);
+spaces_ffi_cursor* spaces_ffi_seek(void* session, uint64_t context, const spaces_ffi_value* name);
+int spaces_ffi_next(spaces_ffi_cursor* cursor, spaces_ffi_value* name, spaces_ffi_value* value);
+void spaces_ffi_close(spaces_ffi_cursor* cursor);
+]]
+
+-- the library require found, its symbols are not global
+local C = ffi.load(package.searchpath and package.searchpath("spaces", package.cpath) or "spaces")
+
+-- spaces::data_type and SPACES_FFI_SPACE
+local NONE, NUMERIC, BOOLEAN, TEXT, SPACE = 0, 1, 2, 3, 16
+
+local value_t = ffi.typeof("spaces_ffi_value")
+local name, value = value_t(), value_t()
+
+local Space = {}
+Space.__index = Space
+
+local function space(session, identity)
+	return setmetatable({session = session, identity = identity}, Space)
+end
+
+local function encode(v, x)
+	local t = type(x)
+	if t == "string" then
+		v.type = TEXT
+		v.bytes = x
+		v.size = #x
+	elseif t == "number" then
+		v.type = NUMERIC
+		v.number = x
+	elseif t == "boolean" then
+		v.type = BOOLEAN
+		v.number = x and 1 or 0
+	elseif x == nil then
+		v.type = NONE
+	else
+		error("spaces_ffi cannot write a "..t)
+	end
+	return v
+end
+
+local function decode(session, v)
+	local t = v.type
+	if t == TEXT then
+		return ffi.string(v.bytes, v.size)
+	elseif t == NUMERIC then
+		return v.number
+	elseif t == BOOLEAN then
+		return v.number ~= 0
+	elseif t == SPACE then
+		return space(session, v.identity)
+	end
+	return nil
+end
+
+function Space:get(k)
+	if C.spaces_ffi_get(self.session, self.identity, encode(name, k), value) == 0 then
+		return nil
+	end
+	return decode(self.session, value)
+end
+
+-- a nil v erases k
+function Space:put(k, v)
+	if C.spaces_ffi_put(self.session, self.identity, encode(name, k), encode(value, v)) == 0 then
+		error("spaces_ffi could not write "..tostring(k))
+	end
+end
+
+-- iterates over the names from lower, or from the first name without it
+function Space:pairs(lower)
+	local session = self.session
+	local c = C.spaces_ffi_seek(session, self.identity, lower ~= nil and encode(name, lower) or nil)
+	if c == nil then
+		return function() return nil end
+	end
+	c = ffi.gc(c, C.spaces_ffi_close)
+	local n, v = value_t(), value_t()
+	return function()
+		if c ~= nil and C.spaces_ffi_next(c, n, v) ~= 0 then
+			return decode(session, n), decode(session, v)
+		end
+		if c ~= nil then
+			C.spaces_ffi_close(ffi.gc(c, nil))
+			c = nil
+		end
+		return nil
+	end
+end
+
+local M = {}
+
+-- returns s wrapped for the ffi, s receives an identity if it has none yet
+function M.wrap(s)
+	return space(spaces.handle(s))
+end
+
+return M
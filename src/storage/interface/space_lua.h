@@ -15,6 +15,8 @@ INCLUDE_SESSION_KEY(SPACES_MAP_ITEM);
 #define SPACES_ITERATOR_NAME "_spaces_iterators"
 #define SPACES_SESSION_LUA_TYPE_NAME "spacesS" //the spaces session 
 #define SPACES_SESSION_NAME "_spaces_sessions"
+#define SPACES_BLOB_LUA_TYPE_NAME "spacesB" //the spaces blob handle
+#define SPACES_BLOB_NAME "_spaces_blobs"
 #define SPACES_G "[]spaces"
 #define SPACES_WRAP_KEY "__$"
 
@@ -153,7 +155,9 @@ namespace spaces{
 			return (n - (i8)n == 0);
 		}
 		spaces::spaces_iterator<_Set>* create_iterator() {
-			return create_instance_from_nothing<spaces::spaces_iterator< _Set>>(L); /* new userdatum is already on the stack */
+			spaces::spaces_iterator<_Set>* i = create_instance_from_nothing<spaces::spaces_iterator< _Set>>(L); /* new userdatum is already on the stack */
+			i->owner = this->get_owner();
+			return i;
 		}
 		spaces::spaces_iterator<_Set>*  get_iterator(int at = 1) {
 			spaces::spaces_iterator<_Set> * i = err_checkudata<spaces::spaces_iterator<_Set>>(L, SPACES_ITERATOR_LUA_TYPE_NAME, at);
@@ -291,7 +295,11 @@ namespace spaces{
 			switch (lt) {
 			case LUA_TNUMBER: {
 				double n = ::lua_tonumber(L, at);
-				d = n;
+				if (spaces::data::is_integral(n)) {
+					d.set_integer((i8)n);
+				} else {
+					d = n;
+				}
 			}break;
 			case LUA_TSTRING: {
 				size_t l = 0;
@@ -303,9 +311,16 @@ namespace spaces{
 				d = b;
 			}break;
 			case LUA_TTABLE: {
-
-				/// TODO: multi data format
-
+				/// a composite of the array part in order, see data::append_part
+				d.set_multi();
+				spaces::data part;
+				size_t n = lua_objlen(L, at);
+				for (size_t i = 1; i <= n; ++i) {
+					lua_rawgeti(L, at, (int)i);
+					to_space_data(part, -1);
+					lua_pop(L, 1);
+					d.append_part(part);
+				}
 			}break;
 			case LUA_TUSERDATA: {
 
@@ -337,6 +352,7 @@ namespace spaces{
 		int push_data(const spaces::data& d) {
 			switch (d.get_type()) {
 			case data_type::numeric:
+			case data_type::integer:
 				lua_pushnumber(L, d.to_number());
 				break;
 			case data_type::boolean:
@@ -345,6 +361,16 @@ namespace spaces{
 			case data_type::text:
 				lua_pushlstring(L, d.get_sequence().c_str(), d.get_sequence().size());
 				break;
+			case data_type::multi: {
+				/// a new table of the parts each time
+				std::vector<spaces::data> parts;
+				d.read_parts(parts);
+				lua_createtable(L, (int)parts.size(), 0);
+				for (size_t i = 0; i < parts.size(); ++i) {
+					push_data(parts[i]);
+					lua_rawseti(L, -2, (int)i + 1);
+				}
+			}break;
 			case data_type::function:
 				lua_pushnil(L);
 				break;
@@ -419,9 +445,9 @@ namespace spaces{
 			case LUA_TNIL:
 				/// delete space under parent using name
 			{
-				//d.set_context(p.get_identity());
-				session_type::session.get_set().erase(d);
-				/// TODO: collect garbage anyone, its wednesday
+				/// the children of a table stay since links may refer to
+				/// them, spaces.clear(s) erases them
+				this->erase(d);
 			}break;
 			default:
 				to_space_data(r.get_value(), at);
@@ -437,19 +463,30 @@ namespace spaces{
 		}
 		int push_pair(const spaces::key& k,const spaces::record& v) {
 			push_data(k.get_name());
-			if (v.get_identity() != 0) {
+			if (this->is_parent(v)) {
 				spaces::space * r = this->open_space(v.get_identity());
 				r->first = k;
 				r->second = v;
 			}
 			else {
-				push_data(v.get_value());
+				push_data(this->map_data(v).get_value());
 			}
 			return 2;
 		}
 		int push_space(const spaces::space& s) {
 			return push_pair(s.first, s.second);
 		}
+		/// pushes the value found at k, a space if it is a parent
+		int push_value(const spaces::key& k, const spaces::record& v) {
+			if (this->is_parent(v)) {
+				spaces::space * r = this->open_space(v.get_identity());
+				r->first = k;
+				r->second = v;
+			} else {
+				push_data(this->map_data(v).get_value());
+			}
+			return 1;
+		}
 	};
 	
 #if 0	
@@ -0,0 +1,53 @@
+//
+// flat C functions over a spaces session for the LuaJIT ffi, see
+// src/examples/spaces_ffi.lua which declares the same functions with
+// ffi.cdef. a session and the identity of a space are returned by
+// spaces.handle(s) in lua
+//
+
+#ifndef SPACES_SPACES_FFI_H
+#define SPACES_SPACES_FFI_H
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+    /// a key name or value, type is one of spaces::data_type or
+    /// SPACES_FFI_SPACE. bytes and size hold text, number holds numbers and
+    /// booleans and identity the space of a table. returned bytes stay valid
+    /// until the next call on the session or cursor
+    typedef struct spaces_ffi_value {
+        int type;
+        const char* bytes;
+        size_t size;
+        double number;
+        uint64_t identity;
+    } spaces_ffi_value;
+
+    /// the type of a value which is a table, identity refers to its space
+    #define SPACES_FFI_SPACE 16
+
+    typedef struct spaces_ffi_cursor spaces_ffi_cursor;
+
+    /// writes the value of name in the space identified by context to
+    /// value, 0 if there is none or name is not text, a number or a boolean
+    int spaces_ffi_get(void* session, uint64_t context, const spaces_ffi_value* name, spaces_ffi_value* value);
+    /// writes value at name in the space identified by context, a value of
+    /// type none erases name. 0 if nothing is written because name or value
+    /// is not text, a number or a boolean or the write failed
+    int spaces_ffi_put(void* session, uint64_t context, const spaces_ffi_value* name, const spaces_ffi_value* value);
+    /// opens a cursor at the first name not less than name in the space
+    /// identified by context, at its first name if name is NULL. NULL if
+    /// name is not text, a number or a boolean or the seek failed
+    spaces_ffi_cursor* spaces_ffi_seek(void* session, uint64_t context, const spaces_ffi_value* name);
+    /// writes the name and value at the cursor and moves past them, 0 once
+    /// the space has no more names
+    int spaces_ffi_next(spaces_ffi_cursor* cursor, spaces_ffi_value* name, spaces_ffi_value* value);
+    void spaces_ffi_close(spaces_ffi_cursor* cursor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SPACES_SPACES_FFI_H
@@ -11,6 +11,8 @@ extern "C" {
 
 #include <storage/interface/space_lua.h>
 
+#include <storage/interface/spaces_ffi.h>
+
 #include <storage/network/replication.h>
 
 #include <storage/transactions/abstracted_storage.h>
@@ -123,13 +125,38 @@ static int l_begin_reader_space(lua_State *L) {
 	return 0;
 }
 
+/// spaces.batch(f) calls f in one write transaction which is committed
+/// once f returns, if f fails it is rolled back and the error raised again.
+/// inside a transaction that is already open f joins it, and committing or
+/// rolling back is left to whoever began it. returns what f returns
+static int l_batch_space(lua_State *L) {
+	luaL_checktype(L, 1, LUA_TFUNCTION);
+	session_t* s = spaces::create_session<session_t>(L, SPACES_SESSION_KEY, false);
+	bool owned = !s->is_transacted();
+	if (owned) {
+		s->begin();
+	}
+	i4 base = lua_gettop(L);
+	lua_pushvalue(L, 1);
+	if (lua_pcall(L, 0, LUA_MULTRET, 0) != 0) {
+		if (owned) {
+			s->rollback();
+		}
+		return lua_error(L);
+	}
+	if (owned) {
+		s->commit();
+	}
+	return lua_gettop(L) - base;
+}
+
 static int l_commit_space(lua_State *L) {
 	spaces::get_session<session_t>(L, SPACES_SESSION_KEY)->commit();
 	return 0;
 }
 
 static int l_rollback_space(lua_State *L) {
-
+	spaces::get_session<session_t>(L, SPACES_SESSION_KEY)->rollback();
 	return 0;
 }
 
@@ -156,8 +183,43 @@ static int l_setmaxmb_space(lua_State *L) {
 	buffer_allocation_pool.set_max_pool_size((1024UL*1024UL*mmb*1UL)/4UL);
     return 0;
 }
+/// spaces.pageSizes(surfaces [, interiors]) sets the slots per page of a new
+/// storage, existing storage keeps the page sizes it was created with
+static int l_page_sizes_space(lua_State *L) {
+	nst::u16 surfaces = (nst::u16)luaL_checkinteger(L, 1);
+	nst::u16 interiors = lua_isnumber(L, 2) ? (nst::u16)lua_tointeger(L, 2) : surfaces;
+	spaces::set_page_sizes(surfaces, interiors);
+	return 0;
+}
+/// spaces.handle(s) returns the session and the identity of s used by the
+/// functions in spaces_ffi.h, s receives an identity if it has none yet
+static int l_handle_space(lua_State *L) {
+	auto s = spaces::get_session<session_t>(L, SPACES_SESSION_KEY);
+	spaces::space* p = s->get_space(1);
+	if (p->second.get_identity() == 0) {
+		s->set_mode(false);
+		s->begin();
+		s->resolve_id(p);
+	}
+	lua_pushlightuserdata(L, s);
+	lua_pushnumber(L, (lua_Number)p->second.get_identity());
+	return 2;
+}
 
 
+static int spaces_get_many(lua_State *L);
+static int spaces_clear(lua_State *L);
+static int spaces_blob(lua_State *L);
+static int spaces_set(lua_State *L);
+static int spaces_set_many(lua_State *L);
+static int spaces_range(lua_State *L);
+static int spaces_count(lua_State *L);
+static int spaces_sum(lua_State *L);
+static int spaces_minmax(lua_State *L);
+static int spaces_exists(lua_State *L);
+
+/// functions on a space are called as spaces.name(s, ...) so that names
+/// stored in a space never hide them
 static const struct luaL_Reg spaces_f[] = {
 	{ "storage", l_configure_space },
     { "serve", l_serve_space},
@@ -168,15 +230,28 @@ static const struct luaL_Reg spaces_f[] = {
 	{ "begin", l_begin_space },
 	{ "beginRead", l_begin_reader_space },
 
+	{ "batch", l_batch_space },
 	{ "commit", l_commit_space },
 	{ "rollback", l_rollback_space },
     { "setMaxMb", l_setmaxmb_space },
+    { "pageSizes", l_page_sizes_space },
     { "replicate", l_replicate_space },
     { "seed", l_seed_space },
 	{ "debug", l_space_debug },
 	{ "quiet", l_space_quiet },
     { "localWrites", l_space_local_writes },
 	{ "observe", l_space_observe },
+	{ "handle", l_handle_space },
+	{ "getMany", spaces_get_many },
+	{ "clear", spaces_clear },
+	{ "blob", spaces_blob },
+	{ "set", spaces_set },
+	{ "setMany", spaces_set_many },
+	{ "range", spaces_range },
+	{ "count", spaces_count },
+	{ "sum", spaces_sum },
+	{ "minmax", spaces_minmax },
+	{ "exists", spaces_exists },
 	{ NULL, NULL } /* sentinel */
 };
 
@@ -247,7 +322,6 @@ static int spaces_index(lua_State *L) {
 
 	s->begin(); /// use whatever mode is set
 	spaces::space k;
-	spaces::space *r = nullptr;
 	spaces::space* p = s->get_space();
 
 	if (p->second.get_identity() != 0) {
@@ -259,16 +333,7 @@ static int spaces_index(lua_State *L) {
 		auto value = s->get_set().direct(k.first);
 
 		if (value != nullptr) {
-
-			if (!value->is_flag(spaces::record::FLAG_LARGE) && value->get_identity() != 0) {
-				r = s->open_space(value->get_identity());
-				r->first = k.first;
-				r->second = *value;
-
-			} else {
-				s->push_data(s->map_data(*value).get_value());
-			}
-
+			s->push_value(k.first, *value);
 		} else {
 			lua_pushnil(L);
 		}
@@ -284,6 +349,148 @@ static int spaces_index(lua_State *L) {
 	return 1;
 
 }
+/// spaces.getMany(s, {k1, k2, ...}) returns a table of the values found at the given
+/// names, names that are not found are left out
+static int spaces_get_many(lua_State *L) {
+	auto s = spaces::get_session<session_t>(L, SPACES_SESSION_KEY);
+	s->begin(); /// use whatever mode is set
+	spaces::space* p = s->get_space(1);
+	luaL_checktype(L, 2, LUA_TTABLE);
+	lua_newtable(L);
+	i4 result = lua_gettop(L);
+	if (p->second.get_identity() == 0) {
+		return 1;
+	}
+	std::vector<spaces::key> names;
+	size_t n = lua_objlen(L, 2);
+	names.reserve(n);
+	for (size_t at = 1; at <= n; ++at) {
+		lua_rawgeti(L, 2, (int)at);
+		i4 lt = lua_type(L, -1);
+		if (lt == LUA_TNUMBER || lt == LUA_TSTRING || lt == LUA_TBOOLEAN) {
+			names.push_back(spaces::key());
+			names.back().set_context(p->second.get_identity());
+			s->to_space_data(names.back().get_name(), -1);
+		}
+		lua_pop(L, 1);
+	}
+	/// sorted names share the descent through the tree
+	std::sort(names.begin(), names.end());
+	std::vector<session_t::_Set::iterator> found;
+	found.reserve(names.size());
+	spaces::find_many(s->get_set(), names.begin(), names.end(), std::back_inserter(found));
+	for (size_t at = 0; at < names.size(); ++at) {
+		if (found[at] == s->get_set().end()) continue;
+		s->push_data(names[at].get_name());
+		s->push_value(names[at], spaces::get_data(found[at]));
+		lua_rawset(L, result);
+	}
+	return 1;
+}
+/// a name and value converted by spaces.set or spaces.setMany before it is written
+struct assignment {
+	spaces::space s;
+	bool erase;
+};
+/// converts the name and value at name and value under p, a nil value erases
+/// the name. tables are written when they are converted like in an assignment
+static void add_assignment(lua_State *L, session_t* s, spaces::space* p, std::vector<assignment>& assigned, i4 name, i4 value) {
+	if (lua_isnil(L, name)) return;
+	assigned.push_back(assignment());
+	assignment& a = assigned.back();
+	a.s.first.set_context(p->second.get_identity());
+	s->to_space_data(a.s.first.get_name(), name);
+	a.erase = lua_isnil(L, value);
+	if (!a.erase) {
+		s->to_space(a.s, value);
+	}
+}
+/// writes the assignments in name order so that consecutive names share the
+/// descent and pages, the last of equal names is written last
+static void write_assigned(session_t* s, std::vector<assignment>& assigned) {
+	std::stable_sort(assigned.begin(), assigned.end(), [](const assignment& l, const assignment& r) {
+		return l.s.first < r.s.first;
+	});
+	for (auto& a : assigned) {
+		if (a.erase) {
+			s->erase(a.s.first);
+		} else {
+			s->insert_or_replace(a.s);
+		}
+	}
+}
+/// spaces.set(s, {k1=v1, k2=v2, ...}) assigns every name in the table in one call
+static int spaces_set(lua_State *L) {
+	auto s = spaces::get_session<session_t>(L, SPACES_SESSION_KEY);
+	s->set_mode(false); /// must write
+	s->begin();
+	spaces::space* p = s->get_space(1);
+	luaL_checktype(L, 2, LUA_TTABLE);
+	s->resolve_id(p);
+	std::vector<assignment> assigned;
+	lua_pushnil(L);
+	while (lua_next(L, 2) != 0) {
+		add_assignment(L, s, p, assigned, -2, -1);
+		lua_pop(L, 1);
+	}
+	write_assigned(s, assigned);
+	return 0;
+}
+/// spaces.setMany(s, {k1, k2, ...}, {v1, v2, ...}) assigns each vi to ki
+/// in one call, a nil vi erases ki
+static int spaces_set_many(lua_State *L) {
+	auto s = spaces::get_session<session_t>(L, SPACES_SESSION_KEY);
+	s->set_mode(false); /// must write
+	s->begin();
+	spaces::space* p = s->get_space(1);
+	luaL_checktype(L, 2, LUA_TTABLE);
+	luaL_checktype(L, 3, LUA_TTABLE);
+	s->resolve_id(p);
+	std::vector<assignment> assigned;
+	size_t n = lua_objlen(L, 2);
+	assigned.reserve(n);
+	for (size_t at = 1; at <= n; ++at) {
+		lua_rawgeti(L, 2, (int)at);
+		lua_rawgeti(L, 3, (int)at);
+		add_assignment(L, s, p, assigned, -2, -1);
+		lua_pop(L, 2);
+	}
+	write_assigned(s, assigned);
+	return 0;
+}
+/// erases all the children of a space and returns how many there were
+static int spaces_clear(lua_State *L) {
+	auto s = spaces::get_session<session_t>(L, SPACES_SESSION_KEY);
+	s->set_mode(false); /// must write
+	s->begin();
+	spaces::space* p = s->get_space(1);
+	lua_pushnumber(L, (lua_Number)s->clear(p));
+	return 1;
+}
+/// spaces.blob(s, name) returns a handle to the text at name which reads it in
+/// parts, or nil if there is no text. the handle reads whatever text is at
+/// name in the transaction it is used in
+static int spaces_blob(lua_State *L) {
+	auto s = spaces::get_session<session_t>(L, SPACES_SESSION_KEY);
+	s->begin(); /// use whatever mode is set
+	spaces::space* p = s->get_space(1);
+	spaces::key k;
+	k.set_context(p->second.get_identity());
+	s->to_space_data(k.get_name(), 2);
+	size_t size = 0;
+	if (p->second.get_identity() == 0 || !s->text_size(k, size)) {
+		lua_pushnil(L);
+		return 1;
+	}
+	spaces::key* b = spaces::create_instance_from_nothing<spaces::key>(L);
+	*b = k;
+	luaL_getmetatable(L, SPACES_BLOB_LUA_TYPE_NAME);
+	if (lua_isnil(L, -1)) {
+		luaL_error(L, "no meta table of type %s", SPACES_BLOB_LUA_TYPE_NAME);
+	}
+	lua_setmetatable(L, -2);
+	return 1;
+}
 static f8 to_number(lua_State *L, i4 at) {
 	f8 r = 0.0;
 	if (lua_isnumber(L, at)) {
@@ -540,31 +747,272 @@ inline const spaces::data make_inf(){
 	inf.make_infinity();
 	return inf;
 }
+inline const spaces::data make_min(){
+	spaces::data min;
+	min.make_minimum();
+	return min;
+}
+/// the options of s(lower, upper, {reverse=true, limit=n, after=name})
+struct range_options {
+	/// from the largest name below upper down to lower
+	bool reverse = false;
+	bool limited = false;
+	size_t limit = 0;
+	/// starts at the first name past after in the direction iterated, so
+	/// that the next page continues from the last name seen
+	bool after = false;
+	spaces::data after_name;
+};
+/// true if the last of t arguments is a table of range options, options
+/// only follow upper and have no array part so that a composite name like
+/// {"user", 43} is never taken for them
+static bool is_range_options(lua_State* L, session_t* s, i4 t) {
+	return t >= 4 && lua_istable(L, t) && s->is_space(t) == nullptr && lua_objlen(L, t) == 0;
+}
+static void to_range_options(lua_State* L, session_t* s, i4 at, range_options& o) {
+	lua_getfield(L, at, "reverse");
+	o.reverse = lua_toboolean(L, -1) != 0;
+	lua_pop(L, 1);
+	lua_getfield(L, at, "limit");
+	if (!lua_isnil(L, -1)) {
+		lua_Number limit = luaL_checknumber(L, -1);
+		o.limited = true;
+		o.limit = limit > 0 ? (size_t)limit : 0;
+	}
+	lua_pop(L, 1);
+	lua_getfield(L, at, "after");
+	if (!lua_isnil(L, -1)) {
+		o.after = true;
+		s->to_space_data(o.after_name, -1);
+	}
+	lua_pop(L, 1);
+}
+/// pushes a counted iterator over [lower, upper) with the options in o, the
+/// names are counted through the tree so that a reverse iterator knows
+/// where to stop
+static int push_iterator(lua_State* L, session_t* s, spaces::space* p, const spaces::data& lower, const spaces::data& upper, const range_options& o){
+	spaces::key f, e, a;
+	f.set_context(p->second.get_identity());
+	e.set_context(p->second.get_identity());
+	a.set_context(p->second.get_identity());
+	f.set_name(lower);
+	e.set_name(upper);
+	a.set_name(o.after_name);
+	lua_iterator_t * pi = s->create_iterator();
+	spaces::seek_range(s->get_set(), *pi, f, e, o.after ? &a : nullptr, o.reverse);
+	if (o.limited) {
+		pi->left = std::min(pi->left, o.limit);
+	}
+
+	luaL_getmetatable(L, SPACES_ITERATOR_LUA_TYPE_NAME);
+	if (lua_isnil(L, -1)) {
+		luaL_error(L, "no meta table of type %s", SPACES_ITERATOR_LUA_TYPE_NAME);
+	}
+	lua_setmetatable(L, -2);
+
+	lua_pushcclosure(L, l_pairs_iter, 1);//i
+	return 1;
+}
 static int spaces___pairs(lua_State* L) {
 
 	auto s = spaces::get_session<session_t>(L, SPACES_SESSION_KEY);
 	s->begin(); /// will start a transaction
 	spaces::space* p = s->get_space();// its at stack 1 because the function is called
-	return push_iterator(L, s, p, spaces::data(),make_inf());
+	return push_iterator(L, s, p, make_min(), make_inf());
 }
 static std::string range = "range";
+/// s(lower, upper) iterates over [lower, upper), a nil lower or upper
+/// leaves the range open at that end. a table of options may follow upper
+/// as a separate argument, see range_options, so lower and upper have to
+/// be given when there are options
+///	for k,v in s(nil, nil, {reverse=true, limit=100}) do ... end
 static int spaces_call(lua_State *L) {
 	int t = lua_gettop(L);
+	auto s = spaces::get_session<session_t>(L, SPACES_SESSION_KEY);
+	range_options options;
+	bool optioned = is_range_options(L, s, t);
+	if (optioned) {
+		to_range_options(L, s, t, options);
+		--t;
+	}
 
 	int o = (t >= 4) ? 1: 0;
-	auto s = spaces::get_session<session_t>(L, SPACES_SESSION_KEY);
 	s->begin(); /// will start a transaction
 	spaces::space* p = s->get_space();// its at stack 1 because the function is called
-	spaces::data lower;
+	spaces::data lower = make_min();
 	spaces::data upper = make_inf();
-	if(t >= o + 2)
+	if(t >= o + 2 && !lua_isnil(L, o + 2))
 		s->to_space_data(lower, o + 2);
-	if(t >= o + 3)
+	if(t >= o + 3 && !lua_isnil(L, o + 3))
 		s->to_space_data(upper, o + 3);
+	else if(lower.is_multi()){
+		/// s{parts} iterates over the composite names that start with the parts
+		upper = lower;
+		upper.make_prefix_end();
+	}
+	if (optioned) {
+		return push_iterator(L, s, p, lower, upper, options);
+	}
 	return push_iterator(L, s, p, lower, upper);
 
 
 }
+/// sets [f, e) to the range of names at 2 and 3 under p, a nil name leaves
+/// the range open at that end and a composite lower alone is a prefix
+static void to_range(lua_State* L, session_t* s, spaces::space* p, spaces::key& f, spaces::key& e) {
+	f.set_context(p->second.get_identity());
+	e.set_context(p->second.get_identity());
+	f.get_name().make_minimum();
+	e.get_name().make_infinity();
+	if (!lua_isnoneornil(L, 2))
+		s->to_space_data(f.get_name(), 2);
+	if (!lua_isnoneornil(L, 3)) {
+		s->to_space_data(e.get_name(), 3);
+	} else if (f.get_name().is_multi()) {
+		e.set_name(f.get_name());
+		e.get_name().make_prefix_end();
+	}
+}
+/// the names returned by each step of spaces.range when no chunk size is given
+static const size_t RANGE_CHUNK = 1024;
+/// returns an array of the next names of a range and an array of their
+/// values, at most as many as the chunk size. upvalues are the counted
+/// iterator and the chunk size
+static int l_range_iter(lua_State* L) {
+	auto s = spaces::get_session<session_t>(L, SPACES_SESSION_KEY);
+	lua_iterator_t *i = s->get_iterator(lua_upvalueindex(1));
+	size_t n = (size_t)lua_tonumber(L, lua_upvalueindex(2));
+	if (i->end()) {
+		return 0;
+	}
+	size_t count = std::min(n, i->left);
+	lua_createtable(L, (int)count, 0);
+	lua_createtable(L, (int)count, 0);
+	i4 values = lua_gettop(L);
+	i4 names = values - 1;
+	size_t at = 0;
+	for (; at < count && !i->end(); i->next()) {
+		++at;
+		s->push_data(spaces::get_key(i->i).get_name());
+		lua_rawseti(L, names, (int)at);
+		s->push_value(spaces::get_key(i->i), spaces::get_data(i->i));
+		lua_rawseti(L, values, (int)at);
+	}
+	return 2;
+}
+/// spaces.range(s, lower, upper, n, offset, limit) iterates over the names in
+/// [lower, upper) n at a time, see l_range_iter. a nil lower or upper
+/// leaves the range open at that end. the first offset names are skipped
+/// and at most limit names are returned
+///	for names, values in spaces.range(s, "a", "b", 100) do ... end
+static int spaces_range(lua_State *L) {
+	auto s = spaces::get_session<session_t>(L, SPACES_SESSION_KEY);
+	s->begin(); /// use whatever mode is set
+	spaces::space* p = s->get_space(1);
+	spaces::key f, e;
+	to_range(L, s, p, f, e);
+	lua_Number n = luaL_optnumber(L, 4, (lua_Number)RANGE_CHUNK);
+	lua_Number offset = luaL_optnumber(L, 5, 0);
+	lua_Number limit = luaL_optnumber(L, 6, std::numeric_limits<lua_Number>::infinity());
+	luaL_argcheck(L, n >= 1, 4, "chunk size should be at least 1");
+	luaL_argcheck(L, offset >= 0, 5, "offset should not be negative");
+	luaL_argcheck(L, limit >= 0, 6, "limit should not be negative");
+	/// counted through the tree so that an offset past the range is known
+	lua_Number left = 0;
+	if (p->second.get_identity() != 0) {
+		left = (lua_Number)spaces::get_count(s->get_set(), f, e) - offset;
+	}
+	left = std::max<lua_Number>(0, std::min(left, limit));
+
+	lua_iterator_t * pi = s->create_iterator();
+	pi->counted = true;
+	pi->left = (size_t)left;
+	pi->e = s->get_set().end();
+	pi->i = left > 0 ? spaces::lower_bound_offset(s->get_set(), f, (size_t)offset) : pi->e;
+	luaL_getmetatable(L, SPACES_ITERATOR_LUA_TYPE_NAME);
+	if (lua_isnil(L, -1)) {
+		luaL_error(L, "no meta table of type %s", SPACES_ITERATOR_LUA_TYPE_NAME);
+	}
+	lua_setmetatable(L, -2);
+	lua_pushnumber(L, n);
+	lua_pushcclosure(L, l_range_iter, 2);
+	return 1;
+}
+/// spaces.count(s, lower, upper) returns the number of names in [lower, upper),
+/// counted through the sub tree counts without visiting them
+static int spaces_count(lua_State *L) {
+	auto s = spaces::get_session<session_t>(L, SPACES_SESSION_KEY);
+	s->begin(); /// use whatever mode is set
+	spaces::space* p = s->get_space(1);
+	spaces::key f, e;
+	to_range(L, s, p, f, e);
+	ptrdiff_t count = 0;
+	if (p->second.get_identity() != 0 && f < e) {
+		count = spaces::get_count(s->get_set(), f, e);
+	}
+	lua_pushnumber(L, (lua_Number)count);
+	return 1;
+}
+/// spaces.exists(s, lower, upper) returns true if there is a name in [lower, upper)
+static int spaces_exists(lua_State *L) {
+	auto s = spaces::get_session<session_t>(L, SPACES_SESSION_KEY);
+	s->begin(); /// use whatever mode is set
+	spaces::space* p = s->get_space(1);
+	spaces::key f, e;
+	to_range(L, s, p, f, e);
+	bool exists = false;
+	if (p->second.get_identity() != 0 && f < e) {
+		auto i = s->get_set().lower_bound(f);
+		exists = i != s->get_set().end() && spaces::get_key(i) < e;
+	}
+	lua_pushboolean(L, exists);
+	return 1;
+}
+/// spaces.sum(s, lower, upper) returns the sum of the numbers in [lower, upper) and
+/// how many there were, other values are skipped
+static int spaces_sum(lua_State *L) {
+	auto s = spaces::get_session<session_t>(L, SPACES_SESSION_KEY);
+	s->begin(); /// use whatever mode is set
+	spaces::space* p = s->get_space(1);
+	spaces::key f, e;
+	to_range(L, s, p, f, e);
+	f8 sum = 0;
+	size_t n = 0;
+	if (p->second.get_identity() != 0) {
+		n = s->for_each_number(f, e, [&sum](f8 v) {
+			sum += v;
+		});
+	}
+	lua_pushnumber(L, sum);
+	lua_pushnumber(L, (lua_Number)n);
+	return 2;
+}
+/// spaces.minmax(s, lower, upper) returns the least and the greatest number in
+/// [lower, upper), nil if there are none
+static int spaces_minmax(lua_State *L) {
+	auto s = spaces::get_session<session_t>(L, SPACES_SESSION_KEY);
+	s->begin(); /// use whatever mode is set
+	spaces::space* p = s->get_space(1);
+	spaces::key f, e;
+	to_range(L, s, p, f, e);
+	f8 least = std::numeric_limits<f8>::infinity();
+	f8 greatest = -std::numeric_limits<f8>::infinity();
+	size_t n = 0;
+	if (p->second.get_identity() != 0) {
+		n = s->for_each_number(f, e, [&least, &greatest](f8 v) {
+			least = std::min(least, v);
+			greatest = std::max(greatest, v);
+		});
+	}
+	if (n == 0) {
+		lua_pushnil(L);
+		lua_pushnil(L);
+	} else {
+		lua_pushnumber(L, least);
+		lua_pushnumber(L, greatest);
+	}
+	return 2;
+}
 
 // meta table for spaces
 const struct luaL_Reg spaces_m[] = {
@@ -595,12 +1043,111 @@ static const struct luaL_Reg spaces_iter_f[] = {
 	{ NULL, NULL } /* sentinel */
 };
 
+/// returns the reader of a collected iterator to the session pool. the tree
+/// iterators are left as they were since the tree may have dropped the pages
+/// they refer to
+static int l_pairs_iter_close(lua_State* L) {
+	lua_iterator_t *i = (lua_iterator_t*)lua_touserdata(L, 1);
+	if (i != nullptr) {
+		i->owner = nullptr;
+	}
+	return 0;
+}
+
 static const struct luaL_Reg spaces_iter_m[] =
 { 
-	//{ "__gc",l_pairs_iter_close },	
+	{ "__gc",l_pairs_iter_close },	
 { NULL, NULL }/* sentinel */
 };
 
+/// pushes at most len bytes of the text at b from offset, nil if there is
+/// no text at b
+static void push_blob_part(lua_State* L, session_t* s, const spaces::key& b, size_t offset, size_t len) {
+	bool found = s->read_text(b, [L, offset, len](const char* bytes, size_t size) {
+		size_t at = std::min(offset, size);
+		lua_pushlstring(L, bytes + at, std::min(len, size - at));
+	});
+	if (!found) {
+		lua_pushnil(L);
+	}
+}
+/// b:size() returns the length of the text or nil if it is gone
+static int l_blob_size(lua_State* L) {
+	auto s = spaces::get_session<session_t>(L, SPACES_SESSION_KEY);
+	s->begin();
+	spaces::key* b = spaces::err_checkudata<spaces::key>(L, SPACES_BLOB_LUA_TYPE_NAME, 1);
+	size_t size = 0;
+	if (s->text_size(*b, size)) {
+		lua_pushnumber(L, (lua_Number)size);
+	} else {
+		lua_pushnil(L);
+	}
+	return 1;
+}
+/// b:read([offset [, len]]) returns len bytes of the text from the zero
+/// based offset, all of it by default
+static int l_blob_read(lua_State* L) {
+	auto s = spaces::get_session<session_t>(L, SPACES_SESSION_KEY);
+	s->begin();
+	spaces::key* b = spaces::err_checkudata<spaces::key>(L, SPACES_BLOB_LUA_TYPE_NAME, 1);
+	lua_Number offset = luaL_optnumber(L, 2, 0);
+	luaL_argcheck(L, offset >= 0, 2, "negative offset");
+	size_t len = std::numeric_limits<size_t>::max();
+	if (!lua_isnoneornil(L, 3)) {
+		lua_Number l = luaL_checknumber(L, 3);
+		luaL_argcheck(L, l >= 0, 3, "negative length");
+		len = (size_t)l;
+	}
+	push_blob_part(L, s, *b, (size_t)offset, len);
+	return 1;
+}
+static int l_blob_part(lua_State* L) {
+	auto s = spaces::get_session<session_t>(L, SPACES_SESSION_KEY);
+	s->begin();
+	spaces::key* b = (spaces::key*)lua_touserdata(L, lua_upvalueindex(1));
+	size_t size = (size_t)lua_tonumber(L, lua_upvalueindex(2));
+	size_t offset = (size_t)lua_tonumber(L, lua_upvalueindex(3));
+	push_blob_part(L, s, *b, offset, size);
+	size_t l = 0;
+	if (lua_isnil(L, -1) || (lua_tolstring(L, -1, &l), l == 0)) {
+		return 0;
+	}
+	lua_pushnumber(L, (lua_Number)(offset + l));
+	lua_replace(L, lua_upvalueindex(3));
+	return 1;
+}
+/// b:chunks([size]) returns an iterator over the text in parts of size
+/// bytes, 64k by default
+static int l_blob_chunks(lua_State* L) {
+	spaces::err_checkudata<spaces::key>(L, SPACES_BLOB_LUA_TYPE_NAME, 1);
+	lua_Number size = luaL_optnumber(L, 2, 65536);
+	luaL_argcheck(L, size >= 1, 2, "chunk size must be positive");
+	lua_pushvalue(L, 1);
+	lua_pushnumber(L, size);
+	lua_pushnumber(L, 0);
+	lua_pushcclosure(L, l_blob_part, 3);
+	return 1;
+}
+static int l_blob_close(lua_State* L) {
+	spaces::key* b = (spaces::key*)lua_touserdata(L, 1);
+	if (b != nullptr) {
+		b->~key();
+	}
+	return 0;
+}
+static const struct luaL_Reg spaces_blob_f[] = {
+	{ NULL, NULL } /* sentinel */
+};
+
+static const struct luaL_Reg spaces_blob_m[] =
+{
+	{ "size", l_blob_size },
+	{ "read", l_blob_read },
+	{ "chunks", l_blob_chunks },
+	{ "__gc", l_blob_close },
+	{ NULL, NULL }/* sentinel */
+};
+
 static int l_session_close(lua_State* L) { 	
 	auto s = spaces::get_session<session_t>(L, SPACES_SESSION_KEY);
 	s->~session_t();
@@ -616,6 +1163,161 @@ static const struct luaL_Reg spaces_session_m[] =
 	{ NULL, NULL }/* sentinel */
 };
 
+/// the functions declared in spaces_ffi.h, they use a session like the meta
+/// methods do but without a lua state so that the LuaJIT ffi can call them
+/// from compiled traces. errors are printed since they cannot be raised
+struct spaces_ffi_cursor {
+	session_t* session;
+	lua_iterator_t i;
+	bool started;
+};
+
+/// false if v is not a type the ffi writes, d is left as it was
+static bool to_ffi_data(spaces::data& d, const spaces_ffi_value* v) {
+	switch (v->type) {
+	case spaces::data_type::numeric:
+	case spaces::data_type::integer:
+		if (spaces::data::is_integral(v->number)) {
+			d.set_integer((i8)v->number);
+		} else {
+			d = v->number;
+		}
+		break;
+	case spaces::data_type::boolean:
+		d = (v->number != 0);
+		break;
+	case spaces::data_type::text:
+		d.set_text(v->bytes, v->size);
+		break;
+	default:
+		return false;
+	}
+	return true;
+}
+
+static void from_ffi_data(spaces_ffi_value* v, const spaces::data& d) {
+	v->bytes = nullptr;
+	v->size = 0;
+	v->number = 0;
+	v->identity = 0;
+	switch (d.get_type()) {
+	case spaces::data_type::numeric:
+	case spaces::data_type::integer:
+	case spaces::data_type::infinity:
+		v->type = spaces::data_type::numeric;
+		v->number = d.to_number();
+		break;
+	case spaces::data_type::boolean:
+		v->type = spaces::data_type::boolean;
+		v->number = (double)d.get_integer();
+		break;
+	case spaces::data_type::text:
+		v->type = spaces::data_type::text;
+		v->bytes = d.get_sequence().readable();
+		v->size = d.get_sequence().size();
+		break;
+	default: /// functions and composites are only read through lua
+		v->type = d.get_type();
+	}
+}
+
+static void from_ffi_record(session_t* s, spaces_ffi_value* v, const spaces::record& r) {
+	if (session_t::is_parent(r)) {
+		from_ffi_data(v, spaces::data());
+		v->type = SPACES_FFI_SPACE;
+		v->identity = r.get_identity();
+		return;
+	}
+	from_ffi_data(v, s->map_data(r).get_value());
+}
+
+extern "C" int spaces_ffi_get(void* session, uint64_t context, const spaces_ffi_value* name, spaces_ffi_value* value) {
+	try {
+		session_t* s = (session_t*)session;
+		s->begin(); /// use whatever mode is set
+		spaces::key k;
+		k.set_context(context);
+		if (!to_ffi_data(k.get_name(), name)) return 0;
+		auto r = s->get_set().direct(k);
+		if (r == nullptr) return 0;
+		from_ffi_record(s, value, *r);
+		return 1;
+	} catch (std::exception& e) {
+		err_print("could not get: %s", e.what());
+	}
+	return 0;
+}
+
+extern "C" int spaces_ffi_put(void* session, uint64_t context, const spaces_ffi_value* name, const spaces_ffi_value* value) {
+	try {
+		session_t* s = (session_t*)session;
+		s->set_mode(false); /// must write
+		s->begin();
+		spaces::key k;
+		k.set_context(context);
+		if (!to_ffi_data(k.get_name(), name)) return 0;
+		if (value->type == spaces::data_type::none) {
+			s->erase(k);
+			return 1;
+		}
+		spaces::record r;
+		if (!to_ffi_data(r.get_value(), value)) return 0;
+		s->insert_or_replace(k, r);
+		return 1;
+	} catch (std::exception& e) {
+		err_print("could not put: %s", e.what());
+	}
+	return 0;
+}
+
+extern "C" spaces_ffi_cursor* spaces_ffi_seek(void* session, uint64_t context, const spaces_ffi_value* name) {
+	try {
+		session_t* s = (session_t*)session;
+		s->begin(); /// use whatever mode is set
+		spaces::key f, e;
+		f.set_context(context);
+		e.set_context(context);
+		f.get_name().make_minimum();
+		if (name != nullptr && !to_ffi_data(f.get_name(), name)) {
+			return nullptr;
+		}
+		e.get_name().make_infinity();
+		spaces_ffi_cursor* c = new spaces_ffi_cursor();
+		c->session = s;
+		c->i.owner = s->get_owner();
+		c->i.i = s->get_set().lower_bound(f);
+		c->i.e = s->get_set().lower_bound(e);
+		c->started = false;
+		return c;
+	} catch (std::exception& e) {
+		err_print("could not seek: %s", e.what());
+	}
+	return nullptr;
+}
+
+/// the cursor only moves on the next call so that the bytes written stay
+/// in the page they were read from until then
+extern "C" int spaces_ffi_next(spaces_ffi_cursor* cursor, spaces_ffi_value* name, spaces_ffi_value* value) {
+	try {
+		if (cursor == nullptr || cursor->i.end()) return 0;
+		if (cursor->started) {
+			cursor->i.next();
+			if (cursor->i.end()) return 0;
+		}
+		cursor->started = true;
+		from_ffi_data(name, spaces::get_key(cursor->i.i).get_name());
+		from_ffi_record(cursor->session, value, spaces::get_data(cursor->i.i));
+		return 1;
+	} catch (std::exception& e) {
+		err_print("could not move cursor: %s", e.what());
+	}
+	return 0;
+}
+
+extern "C" void spaces_ffi_close(spaces_ffi_cursor* cursor) {
+	delete cursor;
+}
+
 #if 0
 #endif
 
@@ -631,6 +1333,7 @@ luaopen_spaces(lua_State * L) {
 	spaces::luaopen_plib_any(L, spaces_m, SPACES_LUA_TYPE_NAME, spaces_f, SPACES_NAME);
 	spaces::luaopen_plib_any(L, spaces_iter_m, SPACES_ITERATOR_LUA_TYPE_NAME, spaces_iter_f, SPACES_ITERATOR_NAME);
 	spaces::luaopen_plib_any(L, spaces_session_m, SPACES_SESSION_LUA_TYPE_NAME, spaces_session_f, SPACES_SESSION_NAME);
+	spaces::luaopen_plib_any(L, spaces_blob_m, SPACES_BLOB_LUA_TYPE_NAME, spaces_blob_f, SPACES_BLOB_NAME);
 	//spaces::luaopen_plib_any(L, spaces_recursor_m, SPACES_LUA_RECUR_NAME, spaces_recursor_f, "_spaces_recursor");
 	lua_newtable(L);
 	lua_pushstring(L,"kv");
@@ -29,37 +29,81 @@ namespace spaces{
 
         }
         ~db_session(){
-
+            if(is_reader){
+                spaces::release_reader(d);
+            }
         }
+        /// readers are shared between sessions through a pool, a reader
+        /// session only holds one between begin and commit
         void create(){
             if(is_reader){
-                d =spaces::create_reader();
+                d = spaces::acquire_reader();
             }else{
                 d = spaces::get_writer();
             }
         }
+        std::shared_ptr<spaces::dbms>& get_dbms(){
+            if(d == nullptr){
+                create();
+            }
+            return d;
+        }
         _Set &get_set() {
-            return d->get_set();
+            return get_dbms()->get_set();
         }
         nst::u64 gen_id(){
-            return d->gen_id();
+            return get_dbms()->gen_id();
+        }
+        nst::stream_address write_value(const char* value, size_t size){
+            return get_dbms()->write_value(value, size);
+        }
+        bool read_value(spaces::data& value, nst::stream_address at){
+            return get_dbms()->read_value(value, at);
+        }
+        template<typename _Function>
+        bool read_value(nst::stream_address at, _Function f){
+            return get_dbms()->read_value(at, f);
+        }
+        void erase_value(nst::stream_address at){
+            get_dbms()->erase_value(at);
         }
         void check(){
-            d->check_resources();
+            get_dbms()->check_resources();
         }
         void set_mode(bool reader){
             if(is_reader != reader){
-                if(d!= nullptr) d->rollback();
+                if(is_reader){
+                    spaces::release_reader(d);
+                }else if(d!= nullptr){
+                    d->rollback();
+                }
                 d = nullptr;
                 is_reader = reader;
                 create();
             }
         }
         void begin() {
-            d->begin();
+            get_dbms()->begin();
+        }
+        bool is_transacted(){
+            return d != nullptr && d->is_transacted();
         }
         void commit() {
-            d->commit();
+            get_dbms()->commit();
+            if(is_reader){
+                spaces::release_reader(d);
+            }
+        }
+        /// discards the writes of the transaction
+        void rollback() {
+            get_dbms()->rollback();
+            if(is_reader){
+                spaces::release_reader(d);
+            }
+        }
+        /// keeps the tree of an iterator from being reused by another session
+        std::shared_ptr<void> get_owner(){
+            return get_dbms();
         }
 
     };
@@ -67,6 +111,7 @@ namespace spaces{
         spaces::_MMap s;
         typedef spaces::_MMap _Set;
         nst::u64 id;
+        std::map<nst::stream_address, std::string> values;
         mem_session(bool) : id(1) {
         }
 
@@ -76,6 +121,27 @@ namespace spaces{
         nst::u64 gen_id(){
             return id++;
         }
+        nst::stream_address write_value(const char* value, size_t size){
+            nst::stream_address at = gen_id();
+            values[at].assign(value, size);
+            return at;
+        }
+        bool read_value(spaces::data& value, nst::stream_address at){
+            auto v = values.find(at);
+            if(v == values.end()) return false;
+            value.set_string(v->second);
+            return true;
+        }
+        template<typename _Function>
+        bool read_value(nst::stream_address at, _Function f){
+            auto v = values.find(at);
+            if(v == values.end()) return false;
+            f(v->second.data(), v->second.size());
+            return true;
+        }
+        void erase_value(nst::stream_address at){
+            values.erase(at);
+        }
         void set_mode(bool) {
 
         }
@@ -84,20 +150,43 @@ namespace spaces{
         }
         void begin() {
 
+        }
+        bool is_transacted(){
+            return false;
         }
         void commit() {
         }
+        void rollback() {
+        }
+        std::shared_ptr<void> get_owner(){
+            return nullptr;
+        }
 
     };
     template<typename _Set>
     struct spaces_iterator {
+        /// the session data the iterators refer to
+        std::shared_ptr<void> owner;
         typename _Set::iterator i;
         typename _Set::iterator e;
+        /// a counted iterator ends after left keys instead of at e, a
+        /// reverse iterator moves to smaller keys and is always counted
+        /// since it cannot move before the first key
+        bool counted = false;
+        bool reverse = false;
+        size_t left = 0;
         bool end() const {
-            return i == e;
+            return counted ? left == 0 : i == e;
         }
         void next() {
-            ++i;
+            if (counted) {
+                --left;
+            }
+            if (!reverse) {
+                ++i;
+            } else if (left > 0) {
+                --i;
+            }
         }
     };
 
@@ -142,6 +231,82 @@ namespace spaces{
         return cnt;
 
     }
+    static ptrdiff_t get_count(spaces::db_session::_Set& s, const spaces::key& lower, const spaces::key& upper) {
+        return s.count(lower, upper);
+    }
+    static ptrdiff_t get_count(spaces::mem_session::_Set& s, const spaces::key& lower, const spaces::key& upper) {
+        return get_count(s.lower_bound(lower), s.lower_bound(upper));
+    }
+    /// returns the key offset keys after lower_bound(lower), the tree finds it
+    /// through its sub tree counts without visiting the keys skipped
+    static spaces::db_session::_Set::iterator lower_bound_offset(spaces::db_session::_Set& s, const spaces::key& lower, size_t offset) {
+        if (offset == 0) return s.lower_bound(lower);
+        return s.select(s.rank(lower) + offset);
+    }
+    static spaces::mem_session::_Set::iterator lower_bound_offset(spaces::mem_session::_Set& s, const spaces::key& lower, size_t offset) {
+        auto i = s.lower_bound(lower);
+        for (; offset > 0 && i != s.end(); --offset) {
+            ++i;
+        }
+        return i;
+    }
+    /// positions i as a counted iterator over the keys in [lower, upper),
+    /// from the largest down when reverse is set. only keys past after in
+    /// the direction iterated are included if it is given
+    template<typename _Set>
+    static void seek_range(_Set& s, spaces_iterator<_Set>& i, const spaces::key& lower, const spaces::key& upper, const spaces::key* after, bool reverse) {
+        i.counted = true;
+        i.reverse = reverse;
+        i.e = s.end();
+        i.left = 0;
+        if (reverse) {
+            /// the keys below upper or below after
+            const spaces::key& h = (after != nullptr && *after < upper) ? *after : upper;
+            if (lower < h) {
+                i.left = get_count(s, lower, h);
+            }
+            i.i = s.lower_bound(h);
+            if (i.left > 0) {
+                --(i.i);
+            }
+        } else if (after != nullptr && !(*after < lower)) {
+            /// the keys past after
+            if (*after < upper) {
+                i.left = get_count(s, *after, upper);
+                if (i.left > 0 && s.find(*after) != s.end()) {
+                    --i.left;
+                }
+            }
+            i.i = s.upper_bound(*after);
+        } else {
+            if (lower < upper) {
+                i.left = get_count(s, lower, upper);
+            }
+            i.i = s.lower_bound(lower);
+        }
+    }
+    /// erases the keys in [lower, upper) and returns how many were erased
+    static ptrdiff_t erase_range(spaces::db_session::_Set& s, const spaces::key& lower, const spaces::key& upper) {
+        return s.erase_range(lower, upper);
+    }
+    static ptrdiff_t erase_range(spaces::mem_session::_Set& s, const spaces::key& lower, const spaces::key& upper) {
+        auto first = s.lower_bound(lower);
+        auto last = s.lower_bound(upper);
+        ptrdiff_t cnt = get_count(first, last);
+        s.erase(first, last);
+        return cnt;
+    }
+    /// writes an iterator or end() for each of the sorted keys to out
+    template<typename _KeyIterator, typename _OutputIterator>
+    static void find_many(spaces::db_session::_Set& s, _KeyIterator first, _KeyIterator last, _OutputIterator out) {
+        s.find_many(first, last, out);
+    }
+    template<typename _KeyIterator, typename _OutputIterator>
+    static void find_many(spaces::mem_session::_Set& s, _KeyIterator first, _KeyIterator last, _OutputIterator out) {
+        for (; first != last; ++first) {
+            *out++ = s.find(*first);
+        }
+    }
 
     template<typename _SessionType>
     class spaces_session {
@@ -173,64 +338,175 @@ namespace spaces{
         void begin() {
             session.begin();
         }
+        /// true while a transaction begun on this session is open
+        bool is_transacted() {
+            return session.is_transacted();
+        }
         void commit() {
             session.commit();
         }
         void rollback() {
-
+            session.rollback();
         }
 
         typename _SessionType::_Set& get_set() {
             return session.get_set();
         }
+        std::shared_ptr<void> get_owner(){
+            return session.get_owner();
+        }
 
         nst::u64 len(const space* p) {
             if (p->second.get_identity() > 0) {
                 spaces::key f, e;
                 f.set_context(p->second.get_identity());
                 e.set_context(p->second.get_identity());
+                f.get_name().make_minimum();
                 e.get_name().make_infinity();
                 ///.set_identity(std::numeric_limits<ui8>::max());
-                auto& s = get_set();
-                // create the iterator
-                typename _Set::iterator fi = s.lower_bound(f);
-                if (fi != s.end()) {
-                    return get_count(fi,s.upper_bound(e));
-
-                }
+                return get_count(get_set(), f, e);
 
             }
             return 0;
         }
 
+        /// erases every key under the identity and returns how many were erased
+        nst::u64 erase_context(nst::u64 identity) {
+            spaces::key f, e;
+            f.set_context(identity);
+            e.set_context(identity);
+            f.get_name().make_minimum();
+            e.get_name().make_infinity();
+            return erase_range(get_set(), f, e);
+        }
+
+        /// true if the identity of v refers to a table and not to its data
+        static bool is_parent(const spaces::record& v) {
+            return v.get_identity() != 0
+                && !v.is_flag(spaces::record::FLAG_LARGE)
+                && !v.is_flag(spaces::record::FLAG_LOGGED);
+        }
+
+        /// erases the record at k and the data kept outside of it, the
+        /// children of a table are kept since links may share them
+        void erase(const spaces::key& k) {
+            auto& s = get_set();
+            auto i = s.find(k);
+            if (i == s.end()) return;
+            const spaces::record& r = get_data(i);
+            nst::u64 identity = r.get_identity();
+            if (r.is_flag(spaces::record::FLAG_LOGGED)) {
+                s.erase(k);
+                session.erase_value(identity);
+            } else if (r.is_flag(spaces::record::FLAG_LARGE) && identity > 0) {
+                s.erase(k);
+                erase_context(identity);
+            } else {
+                s.erase(k);
+            }
+        }
+
+        /// erases all the children of p and the data kept outside of them,
+        /// returns the number of children erased
+        nst::u64 clear(const space* p) {
+            if (p->second.get_identity() == 0) return 0;
+            spaces::key f;
+            f.set_context(p->second.get_identity());
+            f.get_name().make_minimum();
+            std::vector<nst::u64> chunks;
+            std::vector<nst::stream_address> logged;
+            for (auto i = get_set().lower_bound(f); i != get_set().end() && get_key(i).get_context() == f.get_context(); ++i) {
+                const spaces::record& r = get_data(i);
+                if (r.is_flag(spaces::record::FLAG_LOGGED)) {
+                    logged.push_back(r.get_identity());
+                } else if (r.is_flag(spaces::record::FLAG_LARGE) && r.get_identity() > 0) {
+                    chunks.push_back(r.get_identity());
+                }
+            }
+            nst::u64 erased = erase_context(p->second.get_identity());
+            for (auto c : chunks) {
+                erase_context(c);
+            }
+            for (auto a : logged) {
+                session.erase_value(a);
+            }
+            return erased;
+        }
+
+        /// text larger than MAX_BUCKET is written once to a block of its own
+        /// and the record only keeps its address, so that pages stay small
+        /// and splits or merges do not copy it again, the record value keeps
+        /// its size. the block of a value replaced at k is emptied, the
+        /// identity of a table is kept
         void insert_or_replace(spaces::key& k, spaces::record& v) {
             const ui4 MAX_BUCKET = 100;
-            if(v.size() >  MAX_BUCKET){
-                v.set_flag(spaces::record::FLAG_LARGE);
-                spaces::key data_key;
-                spaces::record data;
-                v.set_identity(session.gen_id());
-
+            if(v.size() >  MAX_BUCKET && v.get_identity() == 0){
                 auto& value = v.get_value();
-                ui4 written = 0;
-                ui4 left = value.size();
-                ui4 index = 0;
-                const char * val = value.get_sequence().readable();
-                while(left > 0){
-                    ui4 todo = std::min<ui4>(left,value.size());
-                    data.get_value().set_text(val,todo);
-                    data_key.get_name() = (ui8)index;
-                    data_key.set_context(v.get_identity());
-                    left -= todo;
-                    ++index;
-                    session.get_set()[data_key] = data;
+                const auto& seq = value.get_sequence();
+                v.set_identity(session.write_value(seq.readable(), seq.size()));
+                v.set_flag(spaces::record::FLAG_LOGGED);
+                value.set_integer((i8)seq.size());
+            }
+            spaces::record& stored = session.get_set()[k];
+            /// the identity of a value that is not logged is not a block address
+            bool same = v.is_flag(spaces::record::FLAG_LOGGED) && stored.get_identity() == v.get_identity();
+            if(stored.is_flag(spaces::record::FLAG_LOGGED) && !same){
+                session.erase_value(stored.get_identity());
+            }
+            stored = v;
+        }
+        /// calls f with each number in [lower, upper) as it is in the tree
+        /// slots and returns how many there were. other values, tables and
+        /// the sizes kept for logged text are skipped
+        template<typename _Function>
+        size_t for_each_number(const spaces::key& lower, const spaces::key& upper, _Function f) {
+            size_t n = 0;
+            if (!(lower < upper)) return n;
+            auto& s = get_set();
+            for (auto i = s.lower_bound(lower); i != s.end() && get_key(i) < upper; ++i) {
+                const spaces::record& r = get_data(i);
+                const spaces::data& v = r.get_value();
+                if (r.get_identity() != 0) continue;
+                if (v.is_integer() || v.get_type() == spaces::data_type::numeric) {
+                    f(v.to_number());
+                    ++n;
                 }
-
-                value.clear();
-
             }
-            session.get_set()[k] = v;
+            return n;
+        }
+        /// sets size to the length of the text at k without reading a logged
+        /// value, false if k has no text
+        bool text_size(const spaces::key& k, size_t& size) {
+            auto i = get_set().find(k);
+            if (i == get_set().end()) return false;
+            const spaces::record& r = get_data(i);
+            if (r.is_flag(spaces::record::FLAG_LOGGED)) {
+                size = (size_t)r.get_value().get_integer();
+                return true;
+            }
+            const spaces::data& v = this->map_data(r).get_value();
+            if (!v.is_text()) return false;
+            size = v.get_sequence().size();
+            return true;
+        }
+
+        /// calls f with the bytes and size of the text at k, a logged value is
+        /// passed from the storage buffer without copying it first. false if
+        /// k has no text
+        template<typename _Function>
+        bool read_text(const spaces::key& k, _Function f) {
+            auto i = get_set().find(k);
+            if (i == get_set().end()) return false;
+            const spaces::record& r = get_data(i);
+            if (r.is_flag(spaces::record::FLAG_LOGGED)) {
+                return session.read_value(r.get_identity(), f);
+            }
+            const spaces::data& v = this->map_data(r).get_value();
+            if (!v.is_text()) return false;
+            f(v.get_sequence().readable(), (size_t)v.get_sequence().size());
+            return true;
         }
+
         void insert_or_replace(spaces::space& p) {
             insert_or_replace(p.first,p.second);
         }
@@ -241,6 +517,14 @@ namespace spaces{
         template<typename _DataType>
         spaces::record& map_data(_DataType& original){
 
+            if(original.is_flag(spaces::record::FLAG_LOGGED)){
+                large.set_identity(0);
+                if(!session.read_value(large.get_value(), original.get_identity())){
+                    large.get_value().clear();
+                }
+                return large;
+            }
+            /// chunked values written before values were logged
             if(original.is_flag(spaces::record::FLAG_LARGE)){
                 spaces::key data_key;
                 ui4 index = 0;
@@ -4,10 +4,44 @@
 #include "dbms.h"
 
 static std::shared_ptr<spaces::dbms> writer;
+static nst::u16 surface_page_size = spaces::dbms::_Set::surfaceslotmax;
+static nst::u16 interior_page_size = spaces::dbms::_Set::interiorslotmax;
 std::shared_ptr<spaces::dbms>  spaces::get_writer(){
     if(writer == nullptr){
         writer = std::make_shared<spaces::dbms>(STORAGE_NAME,false);
-
+        writer->get_set().set_page_sizes(surface_page_size, interior_page_size);
     }
     return writer;
 }
+void spaces::set_page_sizes(nst::u16 surfaces, nst::u16 interiors){
+    surface_page_size = surfaces;
+    interior_page_size = interiors;
+    if(writer != nullptr){
+        writer->get_set().set_page_sizes(surfaces, interiors);
+    }
+}
+static Poco::Mutex readers_lock;
+static std::vector<std::shared_ptr<spaces::dbms>> readers;
+std::shared_ptr<spaces::dbms> spaces::acquire_reader(){
+    nst::synchronized l(readers_lock);
+    for(auto r = readers.begin(); r != readers.end(); ++r){
+        if(r->use_count() == 1){
+            std::shared_ptr<spaces::dbms> result = *r;
+            readers.erase(r);
+            return result;
+        }
+    }
+    l.unlock();
+    return create_reader();
+}
+void spaces::release_reader(std::shared_ptr<spaces::dbms>& r){
+    if(r == nullptr) return;
+    std::shared_ptr<spaces::dbms> released = r;
+    r = nullptr;
+    released->rollback();
+    /// a reader that is not kept is closed after the lock is released
+    nst::synchronized l(readers_lock);
+    if(readers.size() < MAX_IDLE_READERS){
+        readers.push_back(released);
+    }
+}
@@ -15,18 +15,36 @@ namespace stx {
     }
 }
 namespace spaces{
-
+	/// front codes the keys of a page, see key::delta_store
+	struct key_interpolator : public stx::interpolator<key> {
+		inline bool encoded(bool) const {
+			return true;
+		}
+		inline nst::u32 encoded_size(const key* prev, const key& k) const {
+			return k.delta_stored(prev);
+		}
+		inline void encode(nst::buffer_type::iterator& writer, const key* prev, const key& k) const {
+			k.delta_store(writer, prev);
+		}
+		inline void decode(const nst::buffer_type& buffer, nst::buffer_type::const_iterator& reader, const key* prev, key& k) const {
+			k.delta_read(buffer, reader, prev);
+		}
+	};
 	class dbms {
 	public:
 
 		stored::abstracted_storage storage;
-		typedef stx::btree_map<key, record, stored::abstracted_storage, std::less<key>> _Set;
+		typedef stx::btree_map<key, record, stored::abstracted_storage, std::less<key>, key_interpolator> _Set;
 	private:
 		_Set set;
 		nst::i64 id;
-		nst::i64 start_id;
+		/// ids below reserved belong to this writer, only reserved is stored
+		nst::i64 reserved;
+		nst::i64 start_reserved;
 		bool is_reader;
 		static const nst::stream_address ID_ADDRESS = 8;
+		/// the number of ids reserved at once
+		static const nst::i64 ID_RANGE = 65536;
 	public:
 		bool reader() const {
 			return  this->is_reader;
@@ -35,6 +53,8 @@ namespace spaces{
         :   storage(name)
         ,   set(storage)
         ,   id(1)
+        ,   reserved(0)
+        ,   start_reserved(0)
         ,   is_reader(is_reader) {
 
             storage.rollback();
@@ -53,18 +73,68 @@ namespace spaces{
 		_Set& get_set() {
 			return set;
 		}
+		/// hands out ids from a range reserved ID_RANGE ids at a time, so that
+		/// the stored boot value only changes when a range is reserved
 		nst::u64 gen_id(){
+		    if(id >= reserved){
+		        reserved = id + ID_RANGE;
+		    }
 		    return id++;
 		}
+		/// writes a value too large for a page to a storage block of its own
+		/// and returns its address, pages then only keep the address
+		nst::stream_address write_value(const char* value, size_t size){
+			nst::stream_address at = 0;
+			nst::buffer_type& buffer = storage.allocate(at, stx::storage::create);
+			buffer.assign((const nst::u8*)value, (const nst::u8*)value + size);
+			storage.complete();
+			return at;
+		}
+		/// calls f with the bytes and size of the value written at address at
+		/// while they are in the storage buffer, false if there is none
+		template<typename _Function>
+		bool read_value(nst::stream_address at, _Function f){
+			const nst::buffer_type& buffer = storage.allocate(at, stx::storage::read);
+			bool r = !storage.is_end(buffer);
+			if(r){
+				f((const char*)buffer.data(), (size_t)buffer.size());
+			}
+			storage.complete();
+			return r;
+		}
+		/// reads the value written at address at, false if there is none
+		bool read_value(data& value, nst::stream_address at){
+			return read_value(at, [&value](const char* bytes, size_t size){
+				value.set_text(bytes, size);
+			});
+		}
+		/// empties the block of a value that is no longer referred to, so that
+		/// merged versions do not keep it
+		void erase_value(nst::stream_address at){
+			nst::buffer_type& buffer = storage.allocate(at, stx::storage::create);
+			buffer.clear();
+			storage.complete();
+		}
 		void begin() {
 			if (!this->storage.is_transacted()) {
 				stored::abstracted_tx_begin(is_reader, false, storage, set);
-                if(!storage.get_boot_value(id,ID_ADDRESS)){
-                    id = 1;
+				nst::i64 stored = 1;
+                if(!storage.get_boot_value(stored,ID_ADDRESS)){
+                    stored = 1;
                 }
-				start_id = id;
+				/// the rest of the range this writer reserved is used until a
+				/// rollback or another writer replaces the stored value
+				if(stored != reserved){
+					id = stored;
+					reserved = stored;
+				}
+				start_reserved = reserved;
 			}
 		}
+		/// true between begin and commit or rollback
+		bool is_transacted() const {
+			return this->storage.is_transacted();
+		}
 		void rollback(){
             if (this->storage.is_transacted()) {
 				dbg_print("rollback  %s on %s",this->storage.get_version().toString().c_str(),storage.get_name().c_str());
@@ -86,10 +156,10 @@ namespace spaces{
 						dbg_print("commit readonly rollback %s on %s",nst::tostring(this->storage.get_version()),storage.get_name().c_str());
 						this->storage.rollback();
 					}else{
-						dbg_print("commit write save id [%lld] %s on %s",(nst::fi64)id,nst::tostring(storage.get_version()),storage.get_name().c_str());
-						if(start_id != id){
-							storage.set_boot_value(id, ID_ADDRESS);
-							start_id = id;
+						dbg_print("commit write save id [%lld] %s on %s",(nst::fi64)reserved,nst::tostring(storage.get_version()),storage.get_name().c_str());
+						if(start_reserved != reserved){
+							storage.set_boot_value(reserved, ID_ADDRESS);
+							start_reserved = reserved;
 						}
 						dbg_print("commit final %s on %s",nst::tostring(storage.get_version()),storage.get_name().c_str());
 						this->set.flush_buffers();
@@ -110,9 +180,20 @@ namespace spaces{
 		}
 	};
 	extern std::shared_ptr<dbms> get_writer();
+	/// sets the slots per surface and interior page used when the writer
+	/// creates its tree, an existing tree keeps its page sizes
+	extern void set_page_sizes(nst::u16 surfaces, nst::u16 interiors);
 	static std::shared_ptr<dbms> create_reader(){
 		return std::make_shared<dbms>(STORAGE_NAME,true);
 	}
+	/// the most readers kept for reuse once released
+	static const size_t MAX_IDLE_READERS = 32;
+	/// returns a released reader that nothing else refers to, so that its
+	/// decoded pages are reused, or a new reader if there is none
+	extern std::shared_ptr<dbms> acquire_reader();
+	/// returns a reader after its transaction ended for use by any thread,
+	/// r is cleared. iterators which still share r keep it from reuse
+	extern void release_reader(std::shared_ptr<dbms>& r);
 }
 #undef __LOG_NAME__
 #define __LOG_NAME__ __LOG_SPACES__
\ No newline at end of file
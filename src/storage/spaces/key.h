@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <iterator>
 #include <limits>
+#include <cmath>
 #include <storage/spaces/data_type.h>
 #include <stx/storage/basic_storage.h>
 #include <rabbit/unordered_map>
@@ -25,38 +26,151 @@ namespace spaces {
 			text, 
 			function,
 			multi,
-			infinity
+			infinity,
+			integer		/// whole numbers, ordered together with numeric
 		};
 	};
+	/// 64 bit hash of bytes taking 8 bytes per step and 32 byte stripes for
+	/// long text, the XXH64 algorithm
+	/// https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+	struct xxh64 {
+		static const nst::u64 P1 = 11400714785074694791ull;
+		static const nst::u64 P2 = 14029467366897019727ull;
+		static const nst::u64 P3 = 1609587929392839161ull;
+		static const nst::u64 P4 = 9650029242287828579ull;
+		static const nst::u64 P5 = 2870177450012600261ull;
+		static nst::u64 rotl(nst::u64 x, int r) {
+			return (x << r) | (x >> (64 - r));
+		}
+		static nst::u64 read64(const unsigned char* p) {
+			nst::u64 v;
+			memcpy(&v, p, sizeof(v));
+			return v;
+		}
+		static nst::u64 read32(const unsigned char* p) {
+			nst::u32 v;
+			memcpy(&v, p, sizeof(v));
+			return v;
+		}
+		static nst::u64 round(nst::u64 acc, nst::u64 input) {
+			acc += input * P2;
+			acc = rotl(acc, 31);
+			return acc * P1;
+		}
+		static nst::u64 merge(nst::u64 acc, nst::u64 v) {
+			acc ^= round(0, v);
+			return acc * P1 + P4;
+		}
+		static nst::u64 hash(const unsigned char* p, size_t count, nst::u64 seed = 0) {
+			const unsigned char* e = p + count;
+			nst::u64 h;
+			if (count >= 32) {
+				nst::u64 v1 = seed + P1 + P2, v2 = seed + P2, v3 = seed, v4 = seed - P1;
+				const unsigned char* limit = e - 32;
+				do {
+					v1 = round(v1, read64(p));
+					v2 = round(v2, read64(p + 8));
+					v3 = round(v3, read64(p + 16));
+					v4 = round(v4, read64(p + 24));
+					p += 32;
+				} while (p <= limit);
+				h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+				h = merge(h, v1);
+				h = merge(h, v2);
+				h = merge(h, v3);
+				h = merge(h, v4);
+			} else {
+				h = seed + P5;
+			}
+			h += count;
+			for (; p + 8 <= e; p += 8) {
+				h ^= round(0, read64(p));
+				h = rotl(h, 27) * P1 + P4;
+			}
+			if (p + 4 <= e) {
+				h ^= read32(p) * P1;
+				h = rotl(h, 23) * P2 + P3;
+				p += 4;
+			}
+			for (; p < e; ++p) {
+				h ^= (*p) * P5;
+				h = rotl(h, 11) * P1;
+			}
+			h ^= h >> 33;
+			h *= P2;
+			h ^= h >> 29;
+			h *= P3;
+			h ^= h >> 32;
+			return h;
+		}
+	};
+	/// text kept in place up to SS bytes, longer text is allocated from the
+	/// allocation pool and the place holds its address and size. with the
+	/// type of data in the byte after it a key is 32 bytes. longer text may
+	/// also be attached to a page buffer instead, see attach()
 	class astring {
 	public:
-		typedef typename std::vector<char, stx::storage::allocation::pool_alloc_tracker<char>> tracked_buffer;
+		typedef stx::storage::allocation::pool_alloc_tracker<char> allocator_type;
 	private:
-		static const i4 SS = 256;
-		ui4 l;
-		i1 sequence[sizeof(tracked_buffer)];
-		tracked_buffer & make_long() {
-			new (sequence) tracked_buffer();
-			l = SS;
-			return (tracked_buffer&)sequence;
-		}
-
-		tracked_buffer&str() {
-			return (tracked_buffer&)sequence;
-		}
-		const tracked_buffer &str() const {
-			return (tracked_buffer&)sequence;
+		static const ui4 SS = 22;
+		static const ui1 LONG = 0xff;
+		static const ui1 ATTACHED = 0xfe;
+		/// allocated text is followed in place by its size and its hash
+		/// once computed, zero if not
+		static const ui4 SIZE_AT = sizeof(char *);
+		static const ui4 HASH_AT = SIZE_AT + sizeof(ui4);
+		static_assert(HASH_AT + sizeof(nst::u64) <= SS, "no place for the hash");
+		struct allocated {
+			char * text;
+			ui4 size;
+		};
+		i1 sequence[SS];
+		ui1 l;
+		allocated get_allocated() const {
+			allocated a;
+			memcpy(&a.text, sequence, sizeof(a.text));
+			memcpy(&a.size, sequence + SIZE_AT, sizeof(a.size));
+			return a;
+		}
+		void set_allocated(char * text, ui4 size) {
+			memcpy(sequence, &text, sizeof(text));
+			memcpy(sequence + SIZE_AT, &size, sizeof(size));
+			set_hash(0);
+			l = LONG;
+		}
+		nst::u64 get_hash() const {
+			nst::u64 h;
+			memcpy(&h, sequence + HASH_AT, sizeof(h));
+			return h;
+		}
+		void set_hash(nst::u64 h) {
+			memcpy(sequence + HASH_AT, &h, sizeof(h));
+		}
+		void free_long() {
+			if (is_long()) {
+				allocated a = get_allocated();
+				allocator_type().deallocate(a.text, a.size);
+				l = 0;
+			} else if (is_attached()) {
+				l = 0;
+			}
 		}
 		void resize(ui4 l, const char * data) {
-			if (l >= sizeof(sequence)) {
-				tracked_buffer &s = make_long();
-				s.resize(l);
-				memcpy(&s[0], data, l);
+			if (l > SS) {
+				char * text = allocator_type().allocate(l);
+				memcpy(text, data, l);
+				free_long();
+				set_allocated(text, l);
 				return;
 			}
-			this->l = l;
-			memcpy(sequence, data, l);
-
+			/// data may be the allocated text
+			bool was_long = is_long();
+			allocated a = get_allocated();
+			memmove(sequence, data, l);
+			this->l = (ui1)l;
+			if (was_long) {
+				allocator_type().deallocate(a.text, a.size);
+			}
 		}
 		SPACES_NOINLINE_PRE /// assume the comparison of long strings will happen less often 
 		i4 compare_data_long(const astring& right) const
@@ -64,42 +178,54 @@ namespace spaces {
 		{
 			return memcmp(data(), right.data(), std::min<i4>(size(), right.size()));
 		}
-		// FNV-1a hash function for bytes
-		// https://en.wikipedia.org/wiki/Fowler%E2%80%93Noll%E2%80%93Vo_hash_function
-		// https://tools.ietf.org/html/draft-eastlake-fnv-13#section-6
-		// used to attempt to fix bad hashes from code
-		size_t fnv_1a_bytes(const unsigned char *bytes, size_t count) const {
-			const unsigned long long FNV64prime = 0x00000100000001B3ull;
-			const unsigned long long FNV64basis = 0xCBF29CE484222325ull;
-			size_t r = FNV64basis;
-			for (size_t a = 0; a < count; ++a){
-				r ^= (size_t)bytes[a]; // folding of one byte at a time
-				r *= FNV64prime;
-			}
-			return r;
-		}
 	public:
-		MSGPACK_DEFINE_ARRAY(l,sequence)
+		/// the hash of allocated text is kept after it is computed
 		size_t hash() const{
-			return fnv_1a_bytes(decoded(),size());
+			if (!is_external()) return (size_t)xxh64::hash(decoded(), size());
+			nst::u64 h = get_hash();
+			if (h == 0) {
+				h = xxh64::hash(decoded(), size());
+				const_cast<astring*>(this)->set_hash(h);
+			}
+			return (size_t)h;
 		}
 		void clear() {
-			if (is_long()) {
-				str().clear();
-			}
-			else {
-				l = 0;
-			}
+			free_long();
+			l = 0;
 		}
 		bool is_long() const {
-			return l == SS;
+			return l == LONG;
+		}
+		bool is_attached() const {
+			return l == ATTACHED;
 		}
+		/// true if the text is not kept in place
+		bool is_external() const {
+			return is_long() || is_attached();
+		}
+		/// refers to text which the caller keeps in place and unchanged while
+		/// it is referred to, any change copies it first. text of up to SS
+		/// bytes is copied
+		void attach(const char * text, ui4 size) {
+			if (size <= SS) {
+				set_data(text, size);
+				return;
+			}
+			free_long();
+			set_allocated(const_cast<char *>(text), size);
+			l = ATTACHED;
+		}
+		/// keeps the text up to the new size
 		void resize(ui4 l) {
-			if (l >= sizeof(sequence)) {
-				make_long().resize(l);
+			if (l == size()) return;
+			if (l > SS) {
+				char * text = allocator_type().allocate(l);
+				memcpy(text, data(), std::min<ui4>(l, size()));
+				free_long();
+				set_allocated(text, l);
 				return;
 			}
-			this->l = l;
+			resize(l, data());
 		}		
 		void set_data(const char * data,ui4 l) {
 			resize(l,data);			
@@ -109,60 +235,63 @@ namespace spaces {
             resize(data.size(),(const char*)data.data());
         }
 		ui4 size() const {
-			return l == SS ? (ui4)(str().size()) :
+			return is_external() ? get_allocated().size :
 				l;
 		}
 		const char *data() const {
-			return l == SS ? str().data() :
+			return is_external() ? get_allocated().text :
 				sequence;
 		}
 		const char *c_str() const {
-			return l == SS ? str().data() :
-				sequence;
+			return data();
 		}
+		/// the text may be changed so a kept hash is cleared and attached text
+		/// is copied
 		char *writable(){
-			return l == SS ? &str()[0] :
-				sequence;
+			if (is_attached()) {
+				allocated a = get_allocated();
+				char * text = allocator_type().allocate(a.size);
+				memcpy(text, a.text, a.size);
+				set_allocated(text, a.size);
+			}
+			if (is_long()) {
+				set_hash(0);
+				return get_allocated().text;
+			}
+			return sequence;
 		}
 		const unsigned char *decoded() const {
 			return (const unsigned char *)data();
 		}
 		const char *readable() const {
-			return l == SS ? &str()[0] :
-				   sequence;
+			return data();
 		}
 		
 		i4 compare(const astring& right) const {
 			i4 r = 0;
-			if (right.l != SS && l != SS) {
+			if (!right.is_external() && !is_external()) {
 				r = memcmp(sequence, right.sequence, std::min<i4>(l, right.l));
 			}
 			else {
 				r = compare_data_long(right);
 			}
 			if (r == 0) {
-				return l - right.l;
+				return (i4)size() - (i4)right.size();
 			}
 			return r;		
 		}
 		astring() : l(0){
-            *((nst::u64*)sequence) = 0ull;
+            memset(sequence, 0, sizeof(nst::u64));
 
 		}
 		astring(const astring& right) : l(0) {
 			*this = right;
 		}
 		~astring() {
-			if (is_long()) {
-			    typedef std::vector<char> vchar;
-				str().~tracked_buffer();
-			}
+			free_long();
 		}
 		astring& operator=(const astring& right) {
-			if (!right.is_long()) {
-				set_data(right.sequence, right.l);
-			}
-			else {
+			if (this != &right) {
 				set_data(right.data(), right.size());
 			}
 			return *this;
@@ -176,11 +305,10 @@ namespace spaces {
 	};
 	class data {
 	private:
-		i4 type;
 		astring sequence;
+		i1 type;
 
 	public:
-		MSGPACK_DEFINE_ARRAY(type,sequence)
 		data(const data&r)
 		: 	sequence(r.sequence)
 		, 	type(r.type){
@@ -262,6 +390,13 @@ namespace spaces {
 			type = data_type::infinity;
 			get_number() = std::numeric_limits<f8>::infinity();
 		}
+		/// makes the least value, ordered before every number so that it can
+		/// open a range at its lower end
+		void make_minimum() {
+			clear();
+			type = data_type::none;
+			get_number() = -std::numeric_limits<f8>::infinity();
+		}
 		void set_text(const i1* s, const size_t l) {
 			clear();
 			type = data_type::text;
@@ -274,6 +409,11 @@ namespace spaces {
 			sequence.set_data(s.data(), (ui4)s.size());
 
 		}
+		void set_integer(i8 i) {
+			clear();
+			type = data_type::integer;
+			get_integer() = i;
+		}
 		template<typename _VectorType>
 		void set_function(const _VectorType& vt) {
 			clear();
@@ -282,9 +422,18 @@ namespace spaces {
 
 		}
 		i4 compare(const data&right) const {
-			if (type != right.type) return type - right.type;
-			if (is_text()) {				
+			if (type != right.type) {
+				if (order_type() != right.order_type()) return order_type() - right.order_type();
+				/// an integer and a number, integers beyond 2^53 are rounded
+				if (to_number() < right.to_number()) return -1;
+				if (to_number() > right.to_number()) return 1;
+				return 0;
+			}
+			if (has_sequence()) {				
 				return sequence.compare(right.sequence);
+			}else if (is_integer()) {
+				if (get_integer() < right.get_integer()) return -1;
+				if (get_integer() > right.get_integer()) return 1;
 			}else {			
 				if(get_number() < right.get_number()) return -1;
 				if(get_number() > right.get_number()) return 1;
@@ -308,11 +457,171 @@ namespace spaces {
 		bool is_text() const {
 			return type == data_type::text;
 		}
+		bool is_integer() const {
+			return type == data_type::integer;
+		}
+		bool is_multi() const {
+			return type == data_type::multi;
+		}
+		/// true if the value is the bytes in sequence, text and composites
+		bool has_sequence() const {
+			return is_text() || is_multi();
+		}
+		/// makes an empty composite, parts are added with append_part
+		void set_multi() {
+			clear();
+			type = data_type::multi;
+		}
+		/// appends the ordered encoding of part to a composite, so that
+		/// composites order like their parts in turn and a composite orders
+		/// directly before the composites it is a prefix of
+		void append_part(const data& part) {
+			nst::buffer_type encoded(part.ordered_size());
+			part.ordered_store(encoded.begin());
+			ui4 at = sequence.size();
+			sequence.resize(at + (ui4)encoded.size());
+			memcpy(sequence.writable() + at, encoded.data(), encoded.size());
+		}
+		/// appends the parts of a composite to parts, numbers are read back as
+		/// numbers. false if the encoding is invalid
+		bool read_parts(std::vector<data>& parts) const {
+			const unsigned char* s = sequence.decoded();
+			nst::buffer_type encoded(s, s + sequence.size());
+			nst::buffer_type::const_iterator reader = encoded.begin();
+			while (reader != encoded.end()) {
+				parts.push_back(data());
+				if (!parts.back().ordered_read(encoded, reader)) return false;
+			}
+			return true;
+		}
+		/// makes a composite the least value after all composites that have it
+		/// as a prefix, no part encoding starts with ordered_escape
+		void make_prefix_end() {
+			ui4 at = sequence.size();
+			sequence.resize(at + 1);
+			sequence.writable()[at] = (i1)ordered_escape;
+		}
+		/// the type that orders this value relative to other types, integers
+		/// are ordered with numbers
+		i4 order_type() const {
+			return is_integer() ? (i4)data_type::numeric : type;
+		}
+		/// the number of leading text bytes shared with r
+		ui4 shared(const data& r) const {
+			if (!has_sequence() || !r.has_sequence()) return 0;
+			ui4 l = std::min<ui4>(sequence.size(), r.sequence.size());
+			const unsigned char* s = sequence.decoded();
+			const unsigned char* rs = r.sequence.decoded();
+			ui4 n = 0;
+			while (n < l && s[n] == rs[n]) ++n;
+			return n;
+		}
+		/// true if the first n text bytes are the same as those of r
+		bool shares(const data& r, ui4 n) const {
+			if (!has_sequence()) return true;
+			return sequence.size() >= n && r.sequence.size() >= n && memcmp(sequence.data(), r.sequence.data(), n) == 0;
+		}
+		/// order preserving value prefix of values of the same type, text is
+		/// taken after the first skip bytes, see compare()
+		nst::u64 value_prefix(ui4 skip) const {
+			nst::u64 v = 0;
+			if (has_sequence()) {
+				/// leading bytes in big endian order as memcmp compares them
+				const unsigned char* s = sequence.decoded();
+				ui4 l = sequence.size() > skip ? std::min<ui4>(sequence.size() - skip, 8) : 0;
+				for (ui4 b = 0; b < l; ++b) {
+					v |= ((nst::u64)s[skip + b]) << (56 - 8 * b);
+				}
+			} else {
+				double d = is_integer() ? (double)get_integer() : get_number();
+				if (d == 0 || d != d) d = 0; /// -0 == 0 and nan is unordered
+				memcpy(&v, &d, sizeof(v));
+				v = (v >> 63) ? ~v : v | 0x8000000000000000ull;
+			}
+			return v;
+		}
+		/// order preserving prefix of the type and value that is bits wide
+		nst::u64 prefix(ui4 bits) const {
+			const nst::u64 tb = 3;
+			const nst::u64 tmax = (1ull << tb) - 1;
+			const i4 type = order_type();
+			/// a truncated type cannot order the value bits after it
+			if (type < 0) return 0;
+			if ((nst::u64)type >= tmax) return tmax << (bits - tb);
+			return ((nst::u64)type << (bits - tb)) | (value_prefix(0) >> (64 - (bits - tb)));
+		}
+		/// order preserving encoding of the type and value: a type byte
+		/// followed by the sign flipped number bits in big endian order or
+		/// the text or composite bytes with zero bytes escaped as 0 0xff and
+		/// ended by 0 1, so that memcmp orders encodings like compare().
+		/// integers are encoded as numbers and read back as numbers
+		enum {
+			ordered_escape = 0xff,
+			ordered_end = 1
+		};
+		nst::u32 ordered_size() const {
+			if (!has_sequence()) return 1 + sizeof(nst::u64);
+			const unsigned char* s = sequence.decoded();
+			nst::u32 r = 1 + sequence.size() + 2;
+			for (ui4 b = 0; b < sequence.size(); ++b) {
+				if (s[b] == 0) ++r;
+			}
+			return r;
+		}
+		nst::buffer_type::iterator ordered_store(nst::buffer_type::iterator writer) const {
+			*writer++ = (nst::u8)order_type();
+			if (has_sequence()) {
+				const unsigned char* s = sequence.decoded();
+				for (ui4 b = 0; b < sequence.size(); ++b) {
+					*writer++ = s[b];
+					if (s[b] == 0) *writer++ = ordered_escape;
+				}
+				*writer++ = 0;
+				*writer++ = ordered_end;
+			} else {
+				nst::u64 v = value_prefix(0);
+				for (ui4 b = 0; b < sizeof(v); ++b) {
+					*writer++ = (nst::u8)(v >> (56 - 8 * b));
+				}
+			}
+			return writer;
+		}
+		/// returns false if the encoding at reader is invalid
+		bool ordered_read(const nst::buffer_type& buffer, nst::buffer_type::const_iterator& reader) {
+			if (reader == buffer.end()) return false;
+			clear();
+			type = *reader++;
+			if (has_sequence()) {
+				std::string s;
+				for (;;) {
+					if (buffer.end() - reader < 2) return false;
+					nst::u8 c = *reader++;
+					if (c == 0) {
+						nst::u8 e = *reader++;
+						if (e == ordered_end) break;
+						if (e != ordered_escape) return false;
+					}
+					s.push_back((char)c);
+				}
+				sequence = s;
+			} else {
+				if ((size_t)(buffer.end() - reader) < sizeof(nst::u64)) return false;
+				nst::u64 v = 0;
+				for (ui4 b = 0; b < sizeof(v); ++b) {
+					v = (v << 8) | *reader++;
+				}
+				v = (v >> 63) ? v & ~0x8000000000000000ull : ~v;
+				memcpy(&get_integer(), &v, sizeof(v));
+			}
+			return true;
+		}
 		f8 to_number() const {
 			char* end;
 			switch (type) {
 			case data_type::numeric:
 				return get_number();
+			case data_type::integer:
+				return (f8)get_integer();
 			case data_type::boolean:
 				return get_number();
 			case data_type::text:
@@ -350,16 +659,20 @@ namespace spaces {
 			nst::i32 ts = sizeof(ui8);
 			nst::i32 ss = sequence.size() + sizeof(sequence.size());
 			nst::i32 ns = sizeof(ui8);
-			return ts + (this->is_text() ? ss : ns);
+			if (this->is_integer()) ns = nst::leb128::signed_size(get_integer());
+			return ts + (this->has_sequence() ? ss : ns);
 		};
 		
 		nst::buffer_type::iterator store(nst::buffer_type::iterator w) const {
 			nst::buffer_type::iterator writer = nst::primitive::store(w, (ui8)this->type);
-			if (this->is_text()) {
+			if (this->has_sequence()) {
 				writer = nst::primitive::store(writer, sequence.size());
 				memcpy((nst::u8*)&(*writer), sequence.data(), sequence.size());
 				writer += sequence.size();
 			}
+			else if (this->is_integer()) {
+				writer = nst::leb128::write_signed(writer, get_integer());
+			}
 			else {
 				writer = nst::primitive::store(writer, get_integer());
 			}
@@ -371,22 +684,33 @@ namespace spaces {
 			return writer;
 		};
 
-		nst::buffer_type::const_iterator read(const nst::buffer_type& buffer, nst::buffer_type::const_iterator r) {
+		/// long text is attached to buffer instead of copied if attach is true,
+		/// see astring::attach
+		nst::buffer_type::const_iterator read(const nst::buffer_type& buffer, nst::buffer_type::const_iterator r, bool attach = false) {
 			
 			nst::buffer_type::const_iterator reader = r;
 			ptrdiff_t diff = reader - r;
 			if (reader != buffer.end()) {
 				ui8 t = 0;
 				reader = nst::primitive::read(t, reader);
+				/// the text may be attached to a buffer that is gone
+				sequence.clear();
 				this->type = t;
-				if (is_text()) {
+				if (has_sequence()) {
 
 					auto s = sequence.size();
 					reader = nst::primitive::read(s, reader);
-					sequence.resize(s);
-					memcpy(sequence.writable(), (nst::u8*)&(*reader), sequence.size());
+					const char * text = (const char *)&(*reader);
+					if (attach) {
+						sequence.attach(text, s);
+					} else {
+						sequence.set_data(text, s);
+					}
 					reader += sequence.size();
 				}
+				else if (is_integer()) {
+					get_integer() = nst::leb128::read_signed64(reader, buffer.end());
+				}
 				else {
 					diff = reader - r;
 					reader = nst::primitive::read(this->get_integer(), reader);
@@ -400,17 +724,146 @@ namespace spaces {
 			}
 			return reader;
 		};
+		/// encodings of a value relative to a preceding value of the same type
+		/// used for front coding keys in a page, see key::delta_store
+		enum {
+			delta_full = 0,		/// the value itself
+			delta_bits = 1,		/// difference of the value bits
+			delta_integral = 2,	/// difference of whole numbers
+			delta_text = 3		/// text sharing leading bytes with the preceding value
+		};
+		/// whole numbers that convert exactly to and from i8
+		static bool is_integral(f8 d) {
+			return d == std::floor(d) && std::fabs(d) < 9007199254740992.0 && !(d == 0 && std::signbit(d));
+		}
+	private:
+		i8 bits_delta(const data& prev) const {
+			return (i8)((ui8)get_integer() - (ui8)prev.get_integer());
+		}
+		i8 integral_delta(const data& prev) const {
+			return (i8)get_number() - (i8)prev.get_number();
+		}
+	public:
+		/// the smallest encoding of this value after prev of the same type
+		ui4 delta_kind(const data& prev) const {
+			if (has_sequence()) {
+				return shared(prev) > 0 ? delta_text : delta_full;
+			}
+			if (is_integer()) {
+				return nst::leb128::signed_size(bits_delta(prev)) < nst::leb128::signed_size(get_integer()) ? delta_bits : delta_full;
+			}
+			ui4 kind = delta_full;
+			nst::u32 size = sizeof(i8);
+			nst::u32 bits = nst::leb128::signed_size(bits_delta(prev));
+			if (bits < size) {
+				kind = delta_bits;
+				size = bits;
+			}
+			if (is_integral(get_number()) && is_integral(prev.get_number())
+				&& (nst::u32)nst::leb128::signed_size(integral_delta(prev)) < size) {
+				kind = delta_integral;
+			}
+			return kind;
+		}
+		/// prev may be NULL for delta_full
+		nst::u32 delta_stored(const data* prev, ui4 kind) const {
+			ui4 n = 0;
+			switch (kind) {
+			case delta_bits:
+				return nst::leb128::signed_size(bits_delta(*prev));
+			case delta_integral:
+				return nst::leb128::signed_size(integral_delta(*prev));
+			case delta_text:
+				n = shared(*prev);
+				return nst::leb128::unsigned_size(n) + nst::leb128::unsigned_size(sequence.size() - n) + sequence.size() - n;
+			default:
+				break;
+			}
+			if (has_sequence()) {
+				return nst::leb128::unsigned_size(sequence.size()) + sequence.size();
+			}
+			if (is_integer()) {
+				return nst::leb128::signed_size(get_integer());
+			}
+			return sizeof(i8);
+		}
+		/// the type is not written and is given to delta_read
+		nst::buffer_type::iterator delta_store(nst::buffer_type::iterator writer, const data* prev, ui4 kind) const {
+			ui4 n = 0;
+			switch (kind) {
+			case delta_bits:
+				return nst::leb128::write_signed(writer, bits_delta(*prev));
+			case delta_integral:
+				return nst::leb128::write_signed(writer, integral_delta(*prev));
+			case delta_text:
+				n = shared(*prev);
+				writer = nst::leb128::write_unsigned(writer, n);
+				break;
+			default:
+				if (is_integer()) {
+					return nst::leb128::write_signed(writer, get_integer());
+				}
+				if (!has_sequence()) {
+					return nst::primitive::store(writer, get_integer());
+				}
+				break;
+			}
+			writer = nst::leb128::write_unsigned(writer, sequence.size() - n);
+			memcpy((nst::u8*)&(*writer), sequence.data() + n, sequence.size() - n);
+			writer += sequence.size() - n;
+			return writer;
+		}
+		void delta_read(const nst::buffer_type& buffer, nst::buffer_type::const_iterator& reader, i4 type, const data* prev, ui4 kind) {
+			ui4 n = 0;
+			this->type = type;
+			switch (kind) {
+			case delta_bits:
+				get_integer() = (i8)((ui8)prev->get_integer() + (ui8)nst::leb128::read_signed64(reader, buffer.end()));
+				return;
+			case delta_integral:
+				get_number() = (f8)((i8)prev->get_number() + nst::leb128::read_signed64(reader, buffer.end()));
+				return;
+			case delta_text:
+				n = (ui4)nst::leb128::read_unsigned64(reader, buffer.end());
+				break;
+			default:
+				if (is_integer()) {
+					get_integer() = nst::leb128::read_signed64(reader, buffer.end());
+					return;
+				}
+				if (!has_sequence()) {
+					reader = nst::primitive::read(get_integer(), reader);
+					return;
+				}
+				break;
+			}
+			ui4 l = (ui4)nst::leb128::read_unsigned64(reader, buffer.end());
+			if ((prev != NULL && n > prev->sequence.size()) || (nst::u64)(buffer.end() - reader) < l) {
+				/// the page size check of the caller reports the failure
+				err_print("invalid encoded text");
+				reader = buffer.end();
+				return;
+			}
+			sequence.resize(n + l);
+			if (n > 0) memcpy(sequence.writable(), prev->sequence.data(), n);
+			memcpy(sequence.writable() + n, (nst::u8*)&(*reader), l);
+			reader += l;
+		}
 
 		size_t hash() const {
 			char* end;
 			switch (type) {
 				case data_type::numeric:
+					/// whole numbers hash like the integers they equal
+					if (is_integral(get_number())) return (size_t)(i8)get_number();
+					return get_integer();
+				case data_type::integer:
 				case data_type::boolean:
 					return get_integer();
 				case data_type::text:
+				case data_type::multi:
 					return this->sequence.hash();
 				//case data_type::function:
-				//case data_type::multi:
 				//case data_type::infinity:
 				default:
 					break;
@@ -447,12 +900,38 @@ namespace spaces {
 		bool operator == (const key&r) const {
 			return !(*this != r);
 		}
+		/// keys order by context then by data::compare on the name, probes in
+		/// the tree are mostly decided by the order preserving prefix() so no
+		/// byte encoding of the whole key is kept beside the front coded pages
 		bool operator < (const key&r) const {
 			if (context != r.context) return context < r.context;			
 			int l = name.compare(r.name);
 			if (l < 0) return true;
 			return false;
 		}
+		/// the extent shared by this key and r used by stx::btree_prefix: zero
+		/// if the contexts or name types differ, else one more than the number
+		/// of leading name bytes shared
+		nst::u32 shared(const key& r) const {
+			if (context != r.context || name.order_type() != r.name.order_type()) return 0;
+			return 1 + name.shared(r.name);
+		}
+		/// true if this key has the extent shared with r
+		bool shares(const key& r, nst::u32 extent) const {
+			if (extent == 0) return true;
+			if (context != r.context || name.order_type() != r.name.order_type()) return false;
+			return name.shares(r.name, extent - 1);
+		}
+		/// order preserving prefix of the key after the shared extent, the
+		/// context and leading name bytes if nothing is shared
+		nst::u64 prefix(nst::u32 extent) const {
+			if (extent > 0) return name.value_prefix(extent - 1);
+			const ui4 cb = 24;
+			const nst::u64 cmax = (1ull << cb) - 1;
+			/// a truncated context cannot order the name bits after it
+			if (context >= cmax) return cmax << (64 - cb);
+			return (context << (64 - cb)) | name.prefix(64 - cb);
+		}
 		bool found (const key&r) const {
 			if (context != r.context) return false;
 			if (name != r.name) return false;
@@ -518,6 +997,65 @@ namespace spaces {
 			}
 			return writer;
 		}
+		/// front coding of a key after the preceding key in a page: a header
+		/// byte flags a context and name type equal to those of prev and
+		/// gives the data::delta_kind of the name, followed by the context
+		/// difference and type if they differ and the name encoded
+		/// relative to the preceding name
+		enum {
+			delta_same_context = 1,
+			delta_same_type = 2,
+			delta_kind_shift = 2
+		};
+	private:
+		ui4 delta_header(const key* prev) const {
+			if (prev == NULL) return 0;
+			ui4 h = 0;
+			if (context == prev->context) h |= delta_same_context;
+			if (name.get_type() == prev->name.get_type()) {
+				h |= delta_same_type | (name.delta_kind(prev->name) << delta_kind_shift);
+			}
+			return h;
+		}
+		i8 context_delta(const key* prev) const {
+			return (i8)(context - (prev ? prev->context : 0));
+		}
+	public:
+		nst::u32 delta_stored(const key* prev) const {
+			ui4 h = delta_header(prev);
+			nst::u32 r = 1;
+			if (!(h & delta_same_context)) r += nst::leb128::signed_size(context_delta(prev));
+			if (!(h & delta_same_type)) return r + nst::leb128::signed_size(name.get_type()) + name.delta_stored(NULL, data::delta_full);
+			return r + name.delta_stored(&prev->name, h >> delta_kind_shift);
+		}
+		void delta_store(nst::buffer_type::iterator& writer, const key* prev) const {
+			ui4 h = delta_header(prev);
+			*writer++ = (nst::u8)h;
+			if (!(h & delta_same_context)) writer = nst::leb128::write_signed(writer, context_delta(prev));
+			if (!(h & delta_same_type)) {
+				writer = nst::leb128::write_signed(writer, name.get_type());
+				writer = name.delta_store(writer, NULL, data::delta_full);
+			} else {
+				writer = name.delta_store(writer, &prev->name, h >> delta_kind_shift);
+			}
+		}
+		void delta_read(const nst::buffer_type& buffer, nst::buffer_type::const_iterator& reader, const key* prev) {
+			if (reader == buffer.end()) return;
+			ui4 h = *reader++;
+			if (prev == NULL && (h & (delta_same_context | delta_same_type))) {
+				err_print("invalid key header");
+				reader = buffer.end();
+				return;
+			}
+			context = prev ? prev->context : 0;
+			if (!(h & delta_same_context)) context += (ui8)nst::leb128::read_signed64(reader, buffer.end());
+			if (!(h & delta_same_type)) {
+				i4 type = (i4)nst::leb128::read_signed64(reader, buffer.end());
+				name.delta_read(buffer, reader, type, NULL, data::delta_full);
+			} else {
+				name.delta_read(buffer, reader, prev->name.get_type(), &prev->name, h >> delta_kind_shift);
+			}
+		}
 		size_t hash() const {
 			return context*31 + name.hash();
 		}
@@ -525,17 +1063,19 @@ namespace spaces {
 	};
 	class record {
 	private:
-		ui4 flags;
 		ui8 identity;
 		// value section
 		data value;
+		ui4 flags;
 
 	public:
 		MSGPACK_DEFINE_ARRAY(flags,identity,value)
 
 		enum FLAGS{
 			FLAG_LARGE = 0,
-			FLAG_ROUTE = 1
+			FLAG_ROUTE = 1,
+			/// the value is kept in a storage block of its own at identity
+			FLAG_LOGGED = 2
 		};
 
 		static const bool use_encoding = true;
@@ -550,7 +1090,7 @@ namespace spaces {
 			this->flags |= (1ul << (ui4)flag);
 		}
 		void clear_flag(FLAGS flag){
-			this->flags |= ~(1ul << (ui4)flag) ;
+			this->flags &= ~(1ul << (ui4)flag) ;
 
 		}
 		bool is_flag(FLAGS flag) const {
@@ -584,8 +1124,15 @@ namespace spaces {
 
 	public:
 
+		/// long text values are attached to the page buffer, which a surface
+		/// node keeps while they refer to it
+		typedef bool attached_values;
+		bool is_attached() const {
+			return value.get_sequence().is_attached();
+		}
+
 		/// persistence functions
-		nst::buffer_type::const_iterator read(const nst::buffer_type& buffer, typename nst::buffer_type::const_iterator& r) {
+		nst::buffer_type::const_iterator read(const nst::buffer_type& buffer, typename nst::buffer_type::const_iterator& r, bool attach = false) {
 			nst::buffer_type::const_iterator reader = r;
 
 			if (reader != buffer.end()) {
@@ -599,7 +1146,7 @@ namespace spaces {
 					reader = nst::primitive::read(this->identity, reader);
 				}
 
-				reader = value.read(buffer, reader);
+				reader = value.read(buffer, reader, attach);
 			}
 			return reader;
 		}
@@ -633,6 +1180,8 @@ namespace spaces {
 		}
 
 	};
+	static_assert(sizeof(data) == 24, "data should be 24 bytes");
+	static_assert(sizeof(key) == 32, "key should be 32 bytes");
 	typedef struct lua_space{
 		lua_space(){
 
@@ -670,4 +1219,122 @@ namespace stx{
 			return k.hash(); ///
 		};
 	};
-}
\ No newline at end of file
+	template<>
+	struct btree_prefix<spaces::key>{
+		static const bool used = true;
+		storage::u32 shared(const spaces::key& first, const spaces::key& last) const{
+			return first.shared(last);
+		};
+		bool shares(const spaces::key& k, const spaces::key& first, storage::u32 extent) const{
+			return k.shares(first, extent);
+		};
+		storage::u64 operator()(const spaces::key& k, storage::u32 extent) const{
+			return k.prefix(extent);
+		};
+	};
+}
+/// msgpack writes the bytes of an astring and the value of a data instead of
+/// their layout in memory, which holds a pointer for long text. keys and
+/// records are arrays of their members
+namespace clmdep_msgpack {
+MSGPACK_API_VERSION_NAMESPACE(MSGPACK_DEFAULT_API_NS) {
+namespace adaptor {
+	/// a bin of the bytes, a str is also read
+	template <>
+	struct pack<spaces::astring> {
+		template <typename Stream>
+		clmdep_msgpack::packer<Stream>& operator()(clmdep_msgpack::packer<Stream>& o, const spaces::astring& v) const {
+			o.pack_bin(v.size());
+			o.pack_bin_body(v.data(), v.size());
+			return o;
+		}
+	};
+	template <>
+	struct convert<spaces::astring> {
+		const clmdep_msgpack::object& operator()(const clmdep_msgpack::object& o, spaces::astring& v) const {
+			switch (o.type) {
+			case clmdep_msgpack::type::BIN:
+				v.set_data(o.via.bin.ptr, o.via.bin.size);
+				break;
+			case clmdep_msgpack::type::STR:
+				v.set_data(o.via.str.ptr, o.via.str.size);
+				break;
+			default:
+				throw clmdep_msgpack::type_error();
+			}
+			return o;
+		}
+	};
+	/// an array of the type and the value, a bin of the bytes of text,
+	/// composites and functions
+	template <>
+	struct pack<spaces::data> {
+		template <typename Stream>
+		clmdep_msgpack::packer<Stream>& operator()(clmdep_msgpack::packer<Stream>& o, const spaces::data& v) const {
+			o.pack_array(2);
+			o.pack((int)v.get_type());
+			switch (v.get_type()) {
+			case spaces::data_type::none:
+				o.pack_nil();
+				break;
+			case spaces::data_type::numeric:
+			case spaces::data_type::infinity:
+				o.pack(v.get_number());
+				break;
+			case spaces::data_type::integer:
+				o.pack(v.get_integer());
+				break;
+			case spaces::data_type::boolean:
+				o.pack(v.get_integer() != 0);
+				break;
+			default:
+				o.pack(v.get_sequence());
+				break;
+			}
+			return o;
+		}
+	};
+	template <>
+	struct convert<spaces::data> {
+		const clmdep_msgpack::object& operator()(const clmdep_msgpack::object& o, spaces::data& v) const {
+			if (o.type != clmdep_msgpack::type::ARRAY || o.via.array.size != 2) {
+				throw clmdep_msgpack::type_error();
+			}
+			const clmdep_msgpack::object& value = o.via.array.ptr[1];
+			switch (o.via.array.ptr[0].as<int>()) {
+			case spaces::data_type::none:
+				v.clear();
+				break;
+			case spaces::data_type::numeric:
+				v = value.as<double>();
+				break;
+			case spaces::data_type::infinity:
+				v.make_infinity();
+				break;
+			case spaces::data_type::integer:
+				v.set_integer(value.as<i8>());
+				break;
+			case spaces::data_type::boolean:
+				v = value.as<bool>();
+				break;
+			case spaces::data_type::text:
+				v.set_text("", 0);
+				value.convert(v.get_sequence());
+				break;
+			case spaces::data_type::multi:
+				v.set_multi();
+				value.convert(v.get_sequence());
+				break;
+			case spaces::data_type::function:
+				v.set_function(std::vector<i1>());
+				value.convert(v.get_sequence());
+				break;
+			default:
+				throw clmdep_msgpack::type_error();
+			}
+			return o;
+		}
+	};
+} // namespace adaptor
+} // MSGPACK_API_VERSION_NAMESPACE(MSGPACK_DEFAULT_API_NS)
+} // namespace clmdep_msgpack
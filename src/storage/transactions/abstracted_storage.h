@@ -23,6 +23,7 @@ this program; if not, write to the Free Software Foundation, Inc.,
 #include <map>
 #include <set>
 #include <vector>
+#include <type_traits>
 #include <rabbit/unordered_map>
 #undef __LOG_NAME__
 #define __LOG_NAME__ "AST"
@@ -381,7 +382,7 @@ namespace stored{
 
 		template<typename _Stored>
 		NS_STORAGE::u32 store_size(const _Stored& k) const {
-			return  k.stored();
+			return  store_size(k, std::is_arithmetic<_Stored>());
 		}
 
 
@@ -389,7 +390,7 @@ namespace stored{
 
 		template<typename _Iterator,typename _Stored>
 		void store(_Iterator& writer, const _Stored& stored) const {
-			writer = stored.store(writer);
+			store(writer, stored, std::is_arithmetic<_Stored>());
 		}
 
 
@@ -397,9 +398,40 @@ namespace stored{
 
 		template<typename _Stored>
 		void retrieve(const nst::buffer_type& buffer, typename nst::buffer_type::const_iterator& reader, _Stored &value) const {
+			retrieve(buffer, reader, value, std::is_arithmetic<_Stored>());
+		}
+	private:
+		/// values with their own persistence functions
+
+		template<typename _Stored>
+		NS_STORAGE::u32 store_size(const _Stored& k, std::false_type) const {
+			return  k.stored();
+		}
+		template<typename _Iterator,typename _Stored>
+		void store(_Iterator& writer, const _Stored& stored, std::false_type) const {
+			writer = stored.store(writer);
+		}
+		template<typename _Stored>
+		void retrieve(const nst::buffer_type& buffer, typename nst::buffer_type::const_iterator& reader, _Stored &value, std::false_type) const {
 			reader = value.read(buffer, reader);
 		}
 
+		/// numbers are stored as they are in memory
+
+		template<typename _Stored>
+		NS_STORAGE::u32 store_size(const _Stored&, std::true_type) const {
+			return sizeof(_Stored);
+		}
+		template<typename _Iterator,typename _Stored>
+		void store(_Iterator& writer, const _Stored& stored, std::true_type) const {
+			writer = NS_STORAGE::primitive::store(writer, stored);
+		}
+		template<typename _Stored>
+		void retrieve(const nst::buffer_type& buffer, typename nst::buffer_type::const_iterator& reader, _Stored &value, std::true_type) const {
+			reader = NS_STORAGE::primitive::read(value, reader);
+		}
+	public:
+
 		/// returns true if a block with given address exists
 		bool contains(nst::stream_address which) {
 			return get_allocations().contains(which);
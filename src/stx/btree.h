@@ -57,6 +57,10 @@ this program; if not, write to the Free Software Foundation, Inc.,
 #include <set>
 #include <map>
 #include <unordered_map>
+#include <type_traits>
+#if defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#endif
 #include <stx/storage/basic_storage.h>
 #include <stx/storage/pool.h>
 
@@ -190,6 +194,9 @@ namespace stx
     /// an iterator intializer pair
     typedef std::pair<mini_pointer, unsigned short> initializer_pair;
 
+    /// the interpolator encodes the keys of a surface page relative to the key
+    /// written before it so that shared leading parts are only stored once.
+    /// the first key of a page is encoded with a NULL predecessor
     template<typename _KeyType>
     struct interpolator {
 
@@ -202,11 +209,15 @@ namespace stx
         inline bool attached_values() const {
             return false;
         }
-        inline void encode(nst::buffer_type::iterator&, const _KeyType*, nst::u16) const {
+        /// the size of k encoded after prev
+        inline nst::u32 encoded_size(const _KeyType*, const _KeyType&) const {
+            return 0;
+        }
+        inline void encode(nst::buffer_type::iterator&, const _KeyType*, const _KeyType&) const {
 
         }
 
-        inline void decode(const nst::buffer_type&, nst::buffer_type::const_iterator&, _KeyType*, nst::u16) const {
+        inline void decode(const nst::buffer_type&, nst::buffer_type::const_iterator&, const _KeyType*, _KeyType&) const {
         }
         template<typename _AnyValue>
         inline void decode_values(const nst::buffer_type&, nst::buffer_type::const_iterator&, _AnyValue*, nst::u16) const {
@@ -218,9 +229,6 @@ namespace stx
         inline size_t encoded_values_size(const _AnyValue*, nst::u16) const {
             return 0;
         }
-        nst::i32 encoded_size(const _KeyType*, nst::u16) {
-            return 0;
-        }
         /// interpolation functions can be an something like linear interpolation
         inline bool can(const _KeyType &, const _KeyType &, nst::i32) const {
             return false;
@@ -492,6 +500,31 @@ namespace stx
         /// merged or slots shifted from it's siblings.
         static const unsigned short mininteriorslots = (interiorslotmax / 2);
 
+        /// Sub tree count of a child whose interior page was written before
+        /// interior nodes kept counts. It is resolved on demand by counting
+        /// the child.
+        static const nst::i64               unknown_count = -1;
+
+        /// Computed B+ tree parameter: True if nodes keep an order preserving
+        /// prefix of each key (see stx::btree_prefix) so that searches compare
+        /// integers and only compare keys when prefixes tie.
+        static const bool                   use_prefixes = stx::btree_prefix<key_type>::used
+                                                           && std::is_same<key_compare, std::less<key_type> >::value;
+
+        /// Computed B+ tree parameter: The number of key prefix slots in each node
+        static const unsigned short         prefixslotmax = !use_prefixes ? 1
+                                                            : (surfaceslotmax > interiorslotmax ? surfaceslotmax : interiorslotmax);
+
+        /// Computed B+ tree parameter: True if surface pages are written as a
+        /// copy of the slot arrays so that loading them does not decode each
+        /// slot. Only trivially copyable keys and values can be copied this way.
+        static const bool                   direct_encode = std::is_trivially_copyable<key_type>::value
+                                                            && std::is_trivially_copyable<data_type>::value;
+
+        /// The encoded key size written in the header of directly encoded
+        /// surface pages, see direct_encode
+        static const nst::i32               direct_page = -1;
+
         /// Debug parameter: Enables expensive and thorough checking of the B+ tree
         /// invariants after each insert/erase operation.
         static const bool                   selfverify = traits::selfverify;
@@ -572,6 +605,15 @@ namespace stx
                 return (*this).ptr != NULL_REF;
             }
 
+            /// hints the processor to fetch the node if it is loaded already
+            inline void prefetch() const {
+#ifndef _MSC_VER
+                if ((*this).ptr != NULL_REF) {
+                    __builtin_prefetch((*this).ptr);
+                }
+#endif
+            }
+
             inline void set_context(btree * context) {
                 if ((*this).context == context) return;
                 if ((*this).context != NULL && context != NULL) {
@@ -1320,6 +1362,60 @@ namespace stx
 
             mutable storage::u16  last_found;
 
+            /// the number of valid key prefixes, zero if they have to be rebuilt
+            mutable storage::u16  prefixed;
+
+            /// the extent shared by all the keys which the prefixes start after
+            mutable storage::u32  prefix_extent;
+
+            /// order preserving prefixes of the keys, built on the first search
+            mutable storage::u64  prefixes[prefixslotmax];
+
+            /// changed with the keys or their count so that point lookup entries
+            /// of the node expire
+            storage::u32  generation;
+
+            /// sets [lower,upper) to the range of the sorted prefixes in [0,o)
+            /// equal to p. With vector extensions the prefixes less than and
+            /// equal to p are counted a vector at a time, without them the bounds
+            /// are binary searched.
+            static inline void bound_prefixes(const storage::u64* prefixes, int o, storage::u64 p, int& lower, int& upper) {
+#if defined(__AVX2__) || defined(__SSE4_2__)
+                int less = 0, equal = 0;
+                int i = 0;
+#if defined(__AVX2__)
+                const __m256i sign = _mm256_set1_epi64x((long long)0x8000000000000000ull);
+                const __m256i key = _mm256_xor_si256(_mm256_set1_epi64x((long long)p), sign);
+                for (; i + 4 <= o; i += 4) {
+                    __m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(prefixes + i)), sign);
+                    int lt = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(key, v)));
+                    int eq = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(key, v)));
+                    less += (lt & 1) + ((lt >> 1) & 1) + ((lt >> 2) & 1) + ((lt >> 3) & 1);
+                    equal += (eq & 1) + ((eq >> 1) & 1) + ((eq >> 2) & 1) + ((eq >> 3) & 1);
+                }
+#else
+                const __m128i sign = _mm_set1_epi64x((long long)0x8000000000000000ull);
+                const __m128i key = _mm_xor_si128(_mm_set1_epi64x((long long)p), sign);
+                for (; i + 2 <= o; i += 2) {
+                    __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(prefixes + i)), sign);
+                    int lt = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(key, v)));
+                    int eq = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(key, v)));
+                    less += (lt & 1) + ((lt >> 1) & 1);
+                    equal += (eq & 1) + ((eq >> 1) & 1);
+                }
+#endif
+                for (; i < o; ++i) {
+                    less += (prefixes[i] < p);
+                    equal += (prefixes[i] == p);
+                }
+                lower = less;
+                upper = less + equal;
+#else
+                lower = (int)(std::lower_bound(prefixes, prefixes + o, p) - prefixes);
+                upper = (int)(std::upper_bound(prefixes + lower, prefixes + o, p) - prefixes);
+#endif
+            }
+
             void check_node() const {
                 if (occupants > interiorslotmax + 1) {
                     err_print("page is probably corrupt");
@@ -1331,6 +1427,8 @@ namespace stx
                 this->context = NULL_REF;
                 is_deleted = 0;
                 last_found = 0;
+                prefixed = 0;
+                prefix_extent = 0;
 
             }
 
@@ -1360,6 +1458,7 @@ namespace stx
 
             void inc_occupants() {
                 ++occupants;
+                ++generation;
 
                 check_node();
             }
@@ -1400,6 +1499,7 @@ namespace stx
                 check_node();
                 if (occupants > 0)
                     --occupants;
+                ++generation;
             }
 
             /// return the key value pair count
@@ -1414,6 +1514,7 @@ namespace stx
             void set_occupants(storage::u16 o) {
                 check_node();
                 occupants = o;
+                ++generation;
             }
 
 
@@ -1437,10 +1538,22 @@ namespace stx
                 version = nst::version_type();
                 transaction = 0;
                 address = 0;
+                prefixed = 0;
+                generation = 0;
 
                 set_context(context);
 
             }
+
+            /// called when keys change so the prefixes are rebuilt before the next
+            /// search and lookup entries of the keys are no longer used
+            inline void invalidate_prefixes() {
+                prefixed = 0;
+                ++generation;
+            }
+            storage::u32 get_generation() const {
+                return generation;
+            }
             bool is_modified() const {
                 check_node();
                 return s != loaded;
@@ -1483,6 +1596,23 @@ namespace stx
                 }
 
                 int l = 0, h = o;
+                if (use_prefixes) {
+                    /// only the keys with the same prefix as key need a full compare
+                    stx::btree_prefix<key_type> prefix;
+                    if (prefixed != o) {
+                        prefix_extent = prefix.shared(node->get_key(0), node->get_key(o - 1));
+                        for (int k = 0; k < o; ++k) {
+                            prefixes[k] = prefix(node->get_key(k), prefix_extent);
+                        }
+                        prefixed = o;
+                    }
+                    /// a key without the shared extent is outside the node keys
+                    if (!prefix.shares(key, node->get_key(0), prefix_extent)) {
+                        return key_lessequal(key_less, key, node->get_key(0)) ? 0 : o;
+                    }
+                    bound_prefixes(prefixes, o, prefix(key, prefix_extent), l, h);
+                    if (l == h) return l;
+                }
 
                 int m;
                 while (l < h) {
@@ -1547,6 +1677,26 @@ namespace stx
                 this->childid[at] = child;
 
             }
+
+            /// return the number of keys in the sub tree of a child
+            nst::i64 get_count(int at) const {
+                return this->counts[at];
+            }
+
+            void set_count(int at, nst::i64 count) {
+                this->counts[at] = count;
+            }
+
+            /// the number of keys in this sub tree or unknown_count if
+            /// any child count is unknown
+            nst::i64 get_total() const {
+                nst::i64 total = 0;
+                for (storage::u16 k = 0; k <= (*this).get_occupants(); ++k) {
+                    if (counts[k] == unknown_count) return unknown_count;
+                    total += counts[k];
+                }
+                return total;
+            }
         private:
             /// Keys of children or data pointers
             key_type        _keys[interiorslotmax];
@@ -1554,8 +1704,12 @@ namespace stx
             /// Pointers to sub trees
             typename node::ptr           childid[interiorslotmax + 1];
 
+            /// Key counts of the sub trees
+            nst::i64        counts[interiorslotmax + 1];
+
             /// keys accessor
             key_type        *keys() {
+                this->invalidate_prefixes();
                 return &_keys[0];
             }
 
@@ -1571,30 +1725,34 @@ namespace stx
 
 
             void set_key(int at,const key_type &key) {
+                this->invalidate_prefixes();
                 _keys[at] = key;
             }
             /// Set variables to initial values
             inline void initialize(btree* context, const unsigned short l)
             {
                 node::initialize(context, l);
+                for (storage::u16 k = 0; k <= interiorslotmax; ++k) {
+                    counts[k] = 0;
+                }
             }
 
             /// True if the node's slots are full
             inline bool isfull() const
             {
-                return (node::get_occupants() == interiorslotmax);
+                return (node::get_occupants() >= node::context->interior_slots);
             }
 
             /// True if few used entries, less than half full
             inline bool isfew() const
             {
-                return (node::get_occupants() <= mininteriorslots);
+                return (node::get_occupants() <= node::context->interior_slots / 2);
             }
 
             /// True if node has too few entries
             inline bool isunderflow() const
             {
-                return (node::get_occupants() < mininteriorslots);
+                return (node::get_occupants() < node::context->interior_slots / 2);
             }
 
             template<typename key_compare, typename key_interpolator >
@@ -1608,27 +1766,36 @@ namespace stx
             /// the buffer type is expected to be some sort of vector although no strict
             /// checking is performed
             template<typename key_interpolator >
-            void load(btree * context, stream_address address, nst::version_type version, storage_type & storage, const buffer_type& buffer, key_interpolator interp)
+            void load(btree * context, stream_address address, nst::version_type version, storage_type & storage, const buffer_type& buffer, size_t load_size, key_interpolator interp)
             {
                 using namespace stx::storage;
                 buffer_type::const_iterator reader = buffer.begin();
+                buffer_type::const_iterator end = buffer.begin() + load_size;
                 (*this).address = address;
+                (*this).invalidate_prefixes();
 
                 (*this).set_occupants(leb128::read_signed(reader));
                 (*this).level = leb128::read_signed(reader);
                 (*this).set_version(version);
                 for (u16 k = 0; k <= interiorslotmax; ++k) {
                     childid[k] = NULL_REF;
+                    counts[k] = unknown_count;
                 }
                 node::check_deleted();
                 for (u16 k = 0; k < (*this).get_occupants(); ++k) {
                     storage.retrieve(buffer, reader, _keys[k]);
                 }
                 for (u16 k = 0; k <= (*this).get_occupants(); ++k) {
-                    stream_address sa = (stream_address)leb128::read_signed64(reader, buffer.end());
+                    stream_address sa = (stream_address)leb128::read_signed64(reader, end);
                     childid[k].set_context(context);
                     childid[k].set_where(sa);
                 }
+                /// pages written before counts were kept end here
+                if (reader < end) {
+                    for (u16 k = 0; k <= (*this).get_occupants(); ++k) {
+                        counts[k] = leb128::read_signed64(reader, end);
+                    }
+                }
                 node::check_deleted();
 
                 this->check_node();
@@ -1648,6 +1815,9 @@ namespace stx
                     storage_use += leb128::signed_size(childid[k].get_where());
                 }
                 storage_use += leb128::signed_size(childid[(*this).get_occupants()].get_where());
+                for (u16 k = 0; k <= (*this).get_occupants(); ++k) {
+                    storage_use += leb128::signed_size(counts[k]);
+                }
 
                 buffer.resize(storage_use);
                 buffer_type::iterator writer = buffer.begin();
@@ -1662,6 +1832,9 @@ namespace stx
                 for (u16 k = 0; k <= (*this).get_occupants(); ++k) {
                     writer = leb128::write_signed(writer, childid[k].get_where());
                 }
+                for (u16 k = 0; k <= (*this).get_occupants(); ++k) {
+                    writer = leb128::write_signed(writer, counts[k]);
+                }
 
                 d = writer - buffer.begin();
                 buffer.resize(d); /// TODO: use swap
@@ -1709,6 +1882,10 @@ namespace stx
 
             /// allocation marker
             nst::u16 allocated;
+
+            /// the point lookup set holding each allocated slot plus one, zero if
+            /// the slot has no entry, see btree::key_cache
+            nst::u16 lookups[surfaceslotmax];
             /// Keys of children or data pointers
             typename std::aligned_storage<sizeof(key_type), alignof(key_type)>::type _keys[surfaceslotmax];
 
@@ -1731,11 +1908,25 @@ namespace stx
             inline key_type &raw_key(i4 at) {
                 return *reinterpret_cast<key_type*>(_keys + permutations[at]);
             }
+            /// adds a decoded slot to the point lookup table
+            void add_lookup(int at) {
+                lookups[permutations[at]] = node::context->add_hash(this, at);
+            }
+            /// removes every point lookup entry referring to this node
+            void remove_lookups() {
+                for (nst::u16 al = 0; al < allocated; ++al) {
+                    if (lookups[al]) {
+                        node::context->erase_lookup(lookups[al] - 1, this);
+                        lookups[al] = 0;
+                    }
+                }
+            }
             void deallocate_data(){
+                this->invalidate_prefixes();
+                this->remove_lookups();
                 for (int at = 0; at < surfaceslotmax; ++at) {
                     nst::u16 al = permutations[at];
                     if ( al != surfaceslotmax) {
-                        node::context->erase_hash(*reinterpret_cast<key_type*>(_keys + al));
                         reinterpret_cast<key_type*>(_keys + al)->~key_type();
                         reinterpret_cast<data_type*>(_values + al)->~data_type();
                     }
@@ -1763,6 +1954,18 @@ namespace stx
             void transfer_attached(buffer_type& attached) {
                 (*this).attached.swap(attached);
             }
+            /// values with an attached_values type may refer to the page buffer
+            /// they are decoded from instead of copying from it, true is
+            /// returned if the value does
+            typedef std::integral_constant<bool, has_typedef_attached_values<data_type>::value> attach_values;
+            static bool retrieve_value(storage_type&, const buffer_type& buffer, buffer_type::const_iterator& reader, data_type& value, std::true_type) {
+                reader = value.read(buffer, reader, true);
+                return value.is_attached();
+            }
+            static bool retrieve_value(storage_type& storage, const buffer_type& buffer, buffer_type::const_iterator& reader, data_type& value, std::false_type) {
+                storage.retrieve(buffer, reader, value);
+                return false;
+            }
             void set_next(const ptr& next) {
 
                 (*this).next = next;
@@ -1813,6 +2016,7 @@ namespace stx
             }
             /// accessor
             void set_kv(i4 at, const key_type &k, const data_type &v){
+                this->invalidate_prefixes();
                 auto &p = permutations[at];
                 if (p == surfaceslotmax) {
                     if (allocated == surfaceslotmax) {
@@ -1829,9 +2033,12 @@ namespace stx
                 }
             }
             void set_key(int at, const key_type& key){
+                this->invalidate_prefixes();
                 init(at);
                 *reinterpret_cast<key_type*>(_keys + permutations[at]) = key;
             }
+            /// the key is not to be changed through the reference, set_key keeps
+            /// the key prefixes valid
             inline key_type &get_key(i4 at) {
                 init(at);
                 return *reinterpret_cast<key_type*>(_keys + permutations[at]);
@@ -1851,6 +2058,7 @@ namespace stx
 
             /// update keys at a position
             void update(int at, const key_type &key, const data_type& value) {
+                this->invalidate_prefixes();
                 get_key(at) = key;
                 get_value(at) = value;
             }
@@ -1859,6 +2067,7 @@ namespace stx
             void insert_(int at, const key_type &key, const data_type& value) {
 
                 BTREE_ASSERT(this->get_occupants() < surfaceslotmax);
+                this->invalidate_prefixes();
                 int j = this->get_occupants();
                 nst::u8 t = permutations[j]; /// because its a resource that might be overwritten
                 for (; j > at; ) {
@@ -1872,7 +2081,7 @@ namespace stx
             }
 
             void copy(int to, const surface_node* other, int start, int count) {
-
+                this->invalidate_prefixes();
                 for (unsigned int slot = start; slot < count; ++slot)
                 {
                     unsigned int ni = to + slot - start;
@@ -1885,7 +2094,7 @@ namespace stx
             }
 
             void erase_d(int slot) {
-                node::context->erase_hash(get_key(slot));
+                this->invalidate_prefixes();
                 for (int i = slot; i < this->get_occupants() - 1; i++)
                 {
                     get_key(i) = get_key(i + 1);
@@ -1893,6 +2102,17 @@ namespace stx
                 }
                 this->dec_occupants();
             }
+            /// erases the slots [from, to)
+            void erase_run(int from, int to) {
+                this->invalidate_prefixes();
+                int run = to - from;
+                for (int i = from; i < this->get_occupants() - run; i++)
+                {
+                    get_key(i) = get_key(i + run);
+                    get_value(i) = get_value(i + run);
+                }
+                this->set_occupants(this->get_occupants() - run);
+            }
             void set_slot_loader(stream_address loader, nst::u16 loaded_slot) {
                 (*this).loaded_slot = loaded_slot;
                 (*this).loader = loader;
@@ -1923,6 +2143,7 @@ namespace stx
                 (*this).preceding = next = NULL_REF;
                 (*this).allocated = 0;
                 ::memset(permutations, surfaceslotmax, sizeof(permutations));
+                ::memset(lookups, 0, sizeof(lookups));
 
             }
             bool unshare() {
@@ -1938,21 +2159,21 @@ namespace stx
 
             inline bool isfull() const
             {
-                return (node::get_occupants() == surfaceslotmax);
+                return (node::get_occupants() >= node::context->surface_slots);
             }
 
             /// True if few used entries, less or equal to half full
 
             inline bool isfew() const
             {
-                return (node::get_occupants() <= minsurfaces);
+                return (node::get_occupants() <= node::context->surface_slots / 2);
             }
 
             /// True if node has too few entries
 
             inline bool isunderflow() const
             {
-                return (node::get_occupants() < minsurfaces);
+                return (node::get_occupants() < node::context->surface_slots / 2);
             }
 
 
@@ -2015,11 +2236,13 @@ namespace stx
                       key_interpolator interp) {
 
                 using namespace stx::storage;
-                bool direct_encode = false;
                 (*this).address = address;
                 (*this).context = context;
+                (*this).invalidate_prefixes();
+                (*this).remove_lookups();
                 /// size_t bs = buffer.size();
                 buffer_type::const_iterator reader = buffer.begin();
+                bool attaching = false;
 
                 (*this).set_occupants(leb128::read_signed(reader));
                 (*this).level = leb128::read_signed(reader);
@@ -2038,22 +2261,45 @@ namespace stx
                 }
                 (*this).next.set_context(context);
                 (*this).next.set_where(sa);
-                if(direct_encode) {
-
-
-                    /// TODO: nb only because vectors are usually allocated contiguously
+                if (encoded_key_size == direct_page) {
+                    if (!btree::direct_encode) {
+                        err_print("directly encoded page for keys or values that are not trivially copyable");
+                        throw bad_format();
+                    }
                     allocated = leb128::read_signed(reader);
+                    size_t direct_size = surfaceslotmax + allocated * (sizeof(key_type) + sizeof(data_type));
+                    if (allocated > surfaceslotmax || (size_t)(buffer.end() - reader) < direct_size) {
+                        err_print("directly encoded page of invalid size");
+                        throw bad_format();
+                    }
+                    /// TODO: nb only because vectors are usually allocated contiguously
                     ::memcpy(permutations, &(*reader), surfaceslotmax);
                     reader += surfaceslotmax;
                     ::memcpy(reinterpret_cast<nst::u8 *>(_keys), &(*reader), allocated * sizeof(key_type));
                     reader += allocated * sizeof(key_type);
                     ::memcpy(reinterpret_cast<nst::u8 *>(_values), &(*reader), allocated * sizeof(data_type));
                     reader += allocated * sizeof(data_type);
+                    for (u16 k = 0; k < (*this).get_occupants(); ++k) {
+                        if (permutations[k] >= allocated) {
+                            err_print("directly encoded page with invalid slot");
+                            throw bad_format();
+                        }
+                        add_lookup(k);
+                    }
                 }else {
 
 
                     if (encoded_key_size > 0) {
-                        //interp.decode(buffer, reader, keys(), (*this).get_occupants());
+                        /// front coded keys, pages written without an interpolator
+                        /// have an encoded key size of zero and are read below
+                        buffer_type::const_iterator start = reader;
+                        for (u16 k = 0; k < (*this).get_occupants(); ++k) {
+                            interp.decode(buffer, reader, k > 0 ? &get_key(k - 1) : NULL, get_key(k));
+                        }
+                        if (reader - start != encoded_key_size) {
+                            err_print("encoded keys of invalid size");
+                            throw bad_format();
+                        }
                     } else {
                         for (u16 k = 0; k < (*this).get_occupants(); ++k) {
                             key_type & key = get_key(k);
@@ -2067,8 +2313,8 @@ namespace stx
                     } else {
 
                         for (u16 k = 0; k < (*this).get_occupants(); ++k) {
-                            storage.retrieve(buffer, reader, get_value(k));
-                            context->add_hash(this,k);
+                            attaching |= retrieve_value(storage, buffer, reader, get_value(k), attach_values());
+                            add_lookup(k);
                         }
                     }
                 }
@@ -2081,14 +2327,11 @@ namespace stx
                 }
                 (*this).sorted = (*this).get_occupants();
 
-
-                if
-                        (
-                        has_typedef_attached_values<key_type>::value
-                        || has_typedef_attached_values<data_type>::value
-                        ) {
-                    //transfer_attached(buffer);
-                    dbg_print("transfer attached\n");
+                if (attaching) {
+                    /// the swapped buffer keeps its bytes in place
+                    transfer_attached(buffer);
+                } else if (!attached.empty()) {
+                    buffer_type().swap(attached);
                 }
             }
 
@@ -2098,11 +2341,14 @@ namespace stx
 
             void save(key_interpolator interp, storage_type &storage, buffer_type& buffer) const {
                 using namespace stx::storage;
-                bool direct_encode = false;
-                nst::i32 encoded_key_size = 0; // (nst::i32)interp.encoded_size(_keys, (*this).get_occupants());
+                /// keys encoded by the interpolator are not copied directly
+                bool direct = btree::direct_encode && !interp.encoded(btree::allow_duplicates);
+                nst::i32 encoded_key_size = direct ? direct_page : 0;
                 nst::i32 encoded_value_size = 0; // (nst::i32)interp.encoded_values_size(values(), (*this).get_occupants());
-                if (!interp.encoded(btree::allow_duplicates)) {
-                    encoded_key_size = 0;
+                if (!direct && interp.encoded(btree::allow_duplicates)) {
+                    for (u16 k = 0; k < (*this).get_occupants(); ++k) {
+                        encoded_key_size += interp.encoded_size(k > 0 ? &get_key(k - 1) : NULL, get_key(k));
+                    }
                 }
                 if (!interp.encoded_values(btree::allow_duplicates)) {
                     encoded_value_size = 0;
@@ -2113,7 +2359,7 @@ namespace stx
                 storage_use += leb128::signed_size(encoded_value_size);
                 storage_use += leb128::signed_size(preceding.get_where());
                 storage_use += leb128::signed_size(next.get_where());
-                if(direct_encode) {
+                if(direct) {
 
 
                     storage_use += leb128::signed_size(allocated);
@@ -2123,7 +2369,7 @@ namespace stx
                     storage_use += allocated * sizeof(data_type);
                 }else {
                     if (encoded_key_size > 0 && interp.encoded(btree::allow_duplicates)) {
-                        //storage_use += encoded_key_size;
+                        storage_use += encoded_key_size;
                     } else {
                         encoded_key_size = 0;
                         storage_use += sizeof(key_type) * (*this).allocated;
@@ -2156,7 +2402,7 @@ namespace stx
                 writer = leb128::write_signed(writer, next.get_where());
 
 
-                if(direct_encode){
+                if(direct){
                     writer = leb128::write_signed(writer, allocated);
                     /// TODO: nb only because vectors are usually allocated contiguously
                     ::memcpy(&(*writer), permutations, surfaceslotmax);
@@ -2169,7 +2415,9 @@ namespace stx
 
 
                     if (encoded_key_size > 0 && interp.encoded(btree::allow_duplicates)) {
-                        //interp.encode(writer, keys(), (*this).get_occupants());
+                        for (u16 k = 0; k < (*this).get_occupants(); ++k) {
+                            interp.encode(writer, k > 0 ? &get_key(k - 1) : NULL, get_key(k));
+                        }
                     } else {
 
 
@@ -2227,14 +2475,6 @@ namespace stx
         _AddressedNodes		surfaces_loaded;
         _AllocatedNodes		modified;
 
-        void erase_hash(const key_type& key){
-            size_t h = stx::btree_hash<key_type>()(key);
-            if(h){
-
-                key_lookup.erase(h);
-            }
-        }
-
         ///	returns NULL if a node with given storage address is not currently
         /// loaded. otherwise returns the currently loaded node
 
@@ -2612,7 +2852,7 @@ namespace stx
                     s = allocate_interior(level, w);
                 }
                 s.set_where(w);
-                s->load(this, w, version, *(get_storage()), load_buffer, key_interpolator());
+                s->load(this, w, version, *(get_storage()), load_buffer, load_size, key_interpolator());
 
                 s.set_state(loaded);
                 s.set_where(w);
@@ -3786,6 +4026,7 @@ namespace stx
                     , pto(OS_CLOCK()), max_use(1024 * 1024 * 8)
                     , changes(0)
                     , last_surface_size(0)
+                    , start_page_sizes(0)
             {
             }
             /// Return the total number of nodes
@@ -3805,6 +4046,7 @@ namespace stx
             stx::storage::i64   start_head;
             stx::storage::i64   start_last;
             stx::storage::i64   start_last_surface_size;
+            stx::storage::i64   start_page_sizes;
         };
 
     private:
@@ -3822,6 +4064,19 @@ namespace stx
         /// Other small statistics about the B+ tree
         tree_stats  stats;
 
+        /// The number of slots used in each surface and interior node, at most
+        /// surfaceslotmax and interiorslotmax. They are kept in the boot values
+        /// so a tree keeps the page sizes it was created with
+        storage::u16 surface_slots;
+        storage::u16 interior_slots;
+
+        /// The page sizes used when the tree is created, see set_page_sizes
+        storage::u16 requested_surface_slots;
+        storage::u16 requested_interior_slots;
+
+        /// Boot value address of the page sizes
+        static const stream_address page_sizes_boot = 6;
+
         /// use lz4 in mem compression otherwize use zlib
 
         static const bool lz4 = true;
@@ -3851,8 +4106,17 @@ namespace stx
             root.set_context(this);
             headsurface.set_context(this);
             last_surface.set_context(this);
+            surface_slots = requested_surface_slots;
+            interior_slots = requested_interior_slots;
             stx::storage::i64 b = 0;
             if (get_storage()->get_boot_value(b)) {
+                /// trees written before page sizes were kept use the largest
+                stx::storage::i64 sizes = 0;
+                if (!get_storage()->get_boot_value(sizes, page_sizes_boot)) {
+                    sizes = encode_page_sizes(surfaceslotmax, interiorslotmax);
+                }
+                decode_page_sizes(sizes);
+                stats.start_page_sizes = sizes;
 
                 restore((stx::storage::stream_address)b);
                 stats.start_root = b;
@@ -3879,6 +4143,10 @@ namespace stx
                 : root(NULL_REF)
                 , headsurface(NULL_REF)
                 , last_surface(NULL_REF)
+                , surface_slots(surfaceslotmax)
+                , interior_slots(interiorslotmax)
+                , requested_surface_slots(surfaceslotmax)
+                , requested_interior_slots(interiorslotmax)
                 , allocator(alloc)
                 , storage(&storage)
         {
@@ -3898,6 +4166,10 @@ namespace stx
                 : root(NULL_REF)
                 , headsurface(NULL_REF)
                 , last_surface(NULL_REF)
+                , surface_slots(surfaceslotmax)
+                , interior_slots(interiorslotmax)
+                , requested_surface_slots(surfaceslotmax)
+                , requested_interior_slots(interiorslotmax)
                 , key_less(kcf)
                 , allocator(alloc)
                 , storage(&storage)
@@ -3918,6 +4190,10 @@ namespace stx
                 : root(NULL_REF)
                 , headsurface(NULL_REF)
                 , last_surface(NULL_REF)
+                , surface_slots(surfaceslotmax)
+                , interior_slots(interiorslotmax)
+                , requested_surface_slots(surfaceslotmax)
+                , requested_interior_slots(interiorslotmax)
                 , allocator(alloc)
                 , storage(&storage)
         {
@@ -3939,6 +4215,10 @@ namespace stx
                 : root(NULL_REF)
                 , headsurface(NULL_REF)
                 , last_surface(NULL_REF)
+                , surface_slots(surfaceslotmax)
+                , interior_slots(interiorslotmax)
+                , requested_surface_slots(surfaceslotmax)
+                , requested_interior_slots(interiorslotmax)
                 , key_less(kcf)
                 , allocator(alloc)
                 , storage(&storage)
@@ -4063,6 +4343,11 @@ namespace stx
                     get_storage()->set_boot_value(stats.last_surface_size, 5);
                     stats.start_last_surface_size = stats.last_surface_size;
                 }
+                stx::storage::i64 sizes = encode_page_sizes(surface_slots, interior_slots);
+                if(stats.start_page_sizes != sizes){
+                    get_storage()->set_boot_value(sizes, page_sizes_boot);
+                    stats.start_page_sizes = sizes;
+                }
 
                 stats.changes = 0;
             }
@@ -4632,6 +4917,8 @@ namespace stx
                     (*this).root = NULL_REF;
                     (*this).last_surface = NULL_REF;
 
+                    /// orphaned surfaces may still be referenced by iterators
+                    key_lookup.clear();
                     unlink_local_nodes();
                     orphan_remaining();
                     nodes_loaded.clear();
@@ -4870,6 +5157,60 @@ namespace stx
         return stats;
     }
 
+    /// The number of slots used in each surface node
+    inline storage::u16 get_surface_slots() const
+    {
+        return surface_slots;
+    }
+
+    /// The number of slots used in each interior node
+    inline storage::u16 get_interior_slots() const
+    {
+        return interior_slots;
+    }
+
+    /// Sets the number of slots used in each surface and interior node of a
+    /// new tree, limited to surfaceslotmax and interiorslotmax. A tree that
+    /// already has a root keeps the page sizes it was created with, in which
+    /// case false is returned.
+    bool set_page_sizes(storage::u16 surfaces, storage::u16 interiors)
+    {
+        requested_surface_slots = limit_page_size(surfaces, surfaceslotmax);
+        requested_interior_slots = limit_page_size(interiors, interiorslotmax);
+        if (root != NULL_REF || stats.tree_size != 0)
+            return false;
+        surface_slots = requested_surface_slots;
+        interior_slots = requested_interior_slots;
+        return true;
+    }
+
+private:
+    /// The smallest page size that still splits and merges into valid nodes
+    static const storage::u16 min_page_slots = 4;
+
+    static storage::u16 limit_page_size(storage::u16 slots, storage::u16 slotmax)
+    {
+        return slots < min_page_slots ? min_page_slots : (slots > slotmax ? slotmax : slots);
+    }
+
+    static stx::storage::i64 encode_page_sizes(storage::u16 surfaces, storage::u16 interiors)
+    {
+        return ((stx::storage::i64)surfaces << 16) | interiors;
+    }
+
+    void decode_page_sizes(stx::storage::i64 sizes)
+    {
+        storage::u16 surfaces = (storage::u16)(sizes >> 16);
+        storage::u16 interiors = (storage::u16)(sizes & 0xFFFF);
+        if (surfaces < min_page_slots || surfaces > surfaceslotmax
+            || interiors < min_page_slots || interiors > interiorslotmax) {
+            err_print("tree page sizes do not fit this build");
+            throw bad_format();
+        }
+        surface_slots = surfaces;
+        interior_slots = interiors;
+    }
+
     public:
     // *** Standard Access Functions Querying the Tree by Descending to a surface
 
@@ -4896,67 +5237,185 @@ namespace stx
     }
 
     struct cache_data {
-        cache_data():key(nullptr),value(nullptr),node(nullptr) {}
-
-        cache_data(const cache_data &right)
-        :   node(right.node)
-        ,   key(right.key)
-        ,   value(right.value) {}
+        cache_data():hash(0),generation(0),node(nullptr),key(nullptr),value(nullptr) {}
 
-        cache_data(surface_node* node,key_type* key,data_type* value)
-        :   node(node)
+        cache_data(size_t hash,nst::u32 generation,surface_node* node,key_type* key,data_type* value)
+        :   hash(hash)
+        ,   generation(generation)
+        ,   node(node)
         ,   key(key)
         ,   value(value)
         {
 
         }
-        cache_data& operator=(const cache_data& right){
-            node = right.node;
-            key = right.key;
-            value = right.value;
-        }
+        size_t hash;
+        /// the generation of the node when the slot was decoded
+        nst::u32 generation;
         surface_node* node;
         key_type* key;
         data_type* value;
     } ;
-    /// a fast lookup table to speedup finds in constant time
-    typedef rabbit::unordered_map<size_t, cache_data> _NodeHash; //, ::sta::tracker<_AllocatedSurfaceNode,::sta::bt_counter>
+    /// a fixed capacity set associative table of decoded slots to speedup
+    /// finds in constant time. each set keeps its most recently used entries
+    /// first and evicts the last one. surfaces remove their entries when they
+    /// are unloaded and entries expire when the keys of their surface change.
+    /// the table is allocated on first use and charged to the tree memory use
+    class key_cache {
+    public:
+        /// number of entries in each set
+        static const size_t ways = 4;
+        /// number of sets, a power of two that fits a surface_node::lookups slot
+        static const size_t sets = 4096;
+        /// number of finds answered from the table
+        nst::u64 hits;
+        /// number of finds which had to search the tree
+        nst::u64 misses;
+        /// number of entries replaced before they were invalidated
+        nst::u64 evictions;
+    private:
+        std::vector<cache_data> entries;
+        size_t used;
+
+        static size_t get_set_index(size_t h) {
+            /// hashes of numeric keys are poorly distributed in the low bits
+            nst::u64 mixed = (nst::u64)h * 0x9E3779B97F4A7C15ull;
+            return (size_t)((mixed >> 32) & (sets - 1));
+        }
+    public:
+        key_cache() : hits(0), misses(0), evictions(0), used(0) {
+        }
+        /// copies do not share decoded slots
+        key_cache(const key_cache&) : hits(0), misses(0), evictions(0), used(0) {
+        }
+        key_cache& operator=(const key_cache&) {
+            clear();
+            return *this;
+        }
+        ~key_cache() {
+            if (!entries.empty()) {
+                remove_btree_totl_used(sets * ways * sizeof(cache_data));
+            }
+        }
+        bool empty() const {
+            return used == 0;
+        }
+        /// the number of bytes allocated for the table
+        size_t capacity_bytes() const {
+            return entries.size() * sizeof(cache_data);
+        }
+        /// removes all entries, the table stays allocated
+        void clear() {
+            if (used) {
+                std::fill(entries.begin(), entries.end(), cache_data());
+                used = 0;
+            }
+        }
+        /// adds an entry and returns its set
+        size_t insert(size_t h, nst::u32 generation, surface_node* node, key_type* key, data_type* value) {
+            if (entries.empty()) {
+                entries.resize(sets * ways);
+                add_btree_totl_used(sets * ways * sizeof(cache_data));
+            }
+            size_t index = get_set_index(h);
+            cache_data* set = &entries[index * ways];
+            size_t last = ways - 1;
+            for (size_t w = 0; w < ways; ++w) {
+                if (set[w].node == nullptr || (set[w].hash == h && set[w].node == node && set[w].key == key)) {
+                    last = w;
+                    break;
+                }
+            }
+            if (set[last].node == nullptr) {
+                ++used;
+            } else if (last == ways - 1 && (set[last].node != node || set[last].key != key)) {
+                ++evictions;
+            }
+            for (size_t w = last; w > 0; --w) {
+                set[w] = set[w - 1];
+            }
+            set[0] = cache_data(h, generation, node, key, value);
+            return index;
+        }
+        /// returns the entry of a hash which is moved to the front of its set
+        /// or nullptr if there is none
+        cache_data* find(size_t h) {
+            if (used) {
+                cache_data* set = &entries[get_set_index(h) * ways];
+                for (size_t w = 0; w < ways && set[w].node != nullptr; ++w) {
+                    if (set[w].hash == h) {
+                        cache_data found = set[w];
+                        for (; w > 0; --w) {
+                            set[w] = set[w - 1];
+                        }
+                        set[0] = found;
+                        return &set[0];
+                    }
+                }
+            }
+            return nullptr;
+        }
+        /// removes the entries of a set which refer to a node
+        void erase(size_t index, const surface_node* node) {
+            if (used) {
+                cache_data* set = &entries[index * ways];
+                size_t to = 0;
+                for (size_t w = 0; w < ways; ++w) {
+                    if (set[w].node != nullptr && set[w].node != node) {
+                        set[to++] = set[w];
+                    } else if (set[w].node != nullptr) {
+                        --used;
+                    }
+                }
+                for (; to < ways; ++to) {
+                    set[to] = cache_data();
+                }
+            }
+        }
+    };
 
     mutable
-    _NodeHash           key_lookup;
-    /// add a hashed key to the lookup table
-    void add_hash(surface_node* node, int at){
+    key_cache           key_lookup;
+    /// add a hashed key to the lookup table and return its set plus one, zero
+    /// if the key has no hash
+    nst::u16 add_hash(surface_node* node, int at){
         data_type &data = node->get_value(at);
         key_type& key = node->get_key(at);
         size_t h = stx::btree_hash<key_type>()(key);
         if(h){
 
-            key_lookup[h] = cache_data(node,&key,&data);
+            return (nst::u16)(key_lookup.insert(h, node->get_generation(), node, &key, &data) + 1);
         }
+        return 0;
+    }
+    /// removes the entries of a surface from a set of the lookup table
+    void erase_lookup(size_t index, const surface_node* node){
+        key_lookup.erase(index, node);
     }
-
 
     /// fast lookup that does not always succeed
-    const data_type * direct(const key_type& key) const {
-
+    data_type * lookup(const key_type& key) const {
         size_t h = stx::btree_hash<key_type>()(key);
-        if(h && !key_lookup.empty()){
-            auto& r = key_lookup[h];
-            if(r.key != nullptr && key_equal(key, *r.key) && is_valid(r.node)){
-                return r.value;
+        if(h){
+            cache_data* r = key_lookup.find(h);
+            if(r != nullptr && r->generation == r->node->get_generation()
+               && key_equal(key, *r->key) && is_valid(r->node)){
+                ++key_lookup.hits;
+                return r->value;
             }
+            ++key_lookup.misses;
         }
         return nullptr;
     }
+    /// the point lookup table with its hit and miss counters
+    const key_cache& get_key_cache() const {
+        return key_lookup;
+    }
+    /// fast lookup that does not always succeed
+    const data_type * direct(const key_type& key) const {
+        return lookup(key);
+    }
     data_type * direct(const key_type& key) {
-        size_t h = stx::btree_hash<key_type>()(key);
-        if(h && !key_lookup.empty()){
-            auto& r = key_lookup[h];
-            if(r.key != nullptr && key_equal(key, *r.key) && is_valid(r.node)){
-                return r.value;
-            }
-        }
-        return nullptr;
+        return lookup(key);
     }
     /// Tries to locate a key in the B+ tree and returns an iterator to the
     /// key/data slot if found. If unsuccessful it returns end().
@@ -5012,6 +5471,75 @@ namespace stx
                ? const_iterator(surface, slot) : end();
     }
 
+    /// Looks up a sorted sequence of keys and writes an iterator to out for
+    /// each key, end() if it is not found. The interior nodes on the path
+    /// to the previous key are kept, so a key only descends from the deepest
+    /// node that also covers it. Adjacent keys in the same surface do not
+    /// descend at all. A key less than the one before it descends from the
+    /// root.
+    template <typename _KeyIterator, typename _OutputIterator>
+    void find_many(_KeyIterator first, _KeyIterator last, _OutputIterator out)
+    {
+        check_low_memory_state();
+
+        if (root == NULL_REF)
+        {
+            for (; first != last; ++first)
+                *out++ = end();
+            return;
+        }
+        /// interior nodes from the root and the child slot taken in each
+        typedef std::pair<typename node::ptr, int> _Step;
+        std::vector<_Step> path;
+        typename surface_node::ptr surface;
+        const key_type* prior = NULL;
+        for (; first != last; ++first)
+        {
+            const key_type& key = *first;
+            if (prior != NULL && key_less(key, *prior))
+                path.clear();
+            prior = &key;
+            /// the first node on the path whose chosen child cannot hold key,
+            /// keys of a child are less or equal to its key in the parent
+            size_t at = path.size();
+            if (at == 0 || surface->get_occupants() == 0
+                || !key_lessequal(key, surface->get_key(surface->get_occupants() - 1)))
+            {
+                for (at = 0; at < path.size(); ++at)
+                {
+                    const interior_node* interior = static_cast<const interior_node*>(path[at].first.operator->());
+                    int slot = path[at].second;
+                    if (slot < interior->get_occupants() && !key_lessequal(key, interior->get_key(slot)))
+                        break;
+                }
+            }
+            if (at < path.size() || path.empty())
+            {
+                typename node::ptr n = at < path.size() ? path[at].first : root;
+                path.resize(at);
+                int slot = 0;
+                stream_address loader = 0;
+                while (!n->issurfacenode())
+                {
+                    typename interior_node::ptr interior = n;
+                    slot = find_lower(interior, key);
+                    loader = interior.get_where();
+                    interior->get_childid(slot).load(interior.get_where(), slot);
+                    if (slot < interior->get_occupants())
+                        interior->get_childid(slot + 1).prefetch();
+                    path.push_back(_Step(n, slot));
+                    n = interior->get_childid(slot);
+                }
+                surface = n;
+                surface->set_slot_loader(loader, slot);
+                surface->get_next().prefetch();
+            }
+            int slot = find_lower(surface.rget(), key);
+            *out++ = (slot < surface->get_occupants() && key_equal(key, surface->get_key(slot)))
+                     ? iterator(surface, slot) : end();
+        }
+    }
+
     /// Tries to locate a key in the B+ tree and returns the number of
     /// identical key entries found.
     size_type count(const key_type &key) const
@@ -5152,6 +5680,105 @@ namespace stx
         return std::pair<const_iterator, const_iterator>(lower_bound(key), upper_bound(key));
     }
 
+    public:
+    // *** Order Statistics Using the Sub Tree Counts of Interior Nodes
+
+    /// Returns the number of keys less than key, which is the position of
+    /// lower_bound(key). Descends once from the root to a surface.
+    size_type rank(const key_type& key)
+    {
+        typename node::ptr n = root;
+        if (n == NULL_REF) return 0;
+        size_type r = 0;
+
+        while (!n->issurfacenode())
+        {
+            typename interior_node::ptr interior = n;
+            int slot = find_lower(interior, key);
+            for (int c = 0; c < slot; ++c)
+            {
+                r += child_count(interior, c);
+            }
+            n = interior->get_childid(slot);
+        }
+
+        typename surface_node::ptr surface = n;
+        return r + find_lower(surface, key);
+    }
+
+    /// Returns the number of keys in the range [lower, upper) without
+    /// visiting the surfaces in between.
+    size_type count(const key_type& lower, const key_type& upper)
+    {
+        size_type l = rank(lower);
+        size_type u = rank(upper);
+        return u > l ? u - l : 0;
+    }
+
+    /// Returns an iterator to the n'th key in the tree or end() if there are
+    /// n or fewer keys.
+    iterator select(size_type n)
+    {
+        if (root == NULL_REF || n >= size()) return end();
+        typename node::ptr c = root;
+
+        while (!c->issurfacenode())
+        {
+            typename interior_node::ptr interior = c;
+            int slot = 0;
+            for (; slot < interior->get_occupants(); ++slot)
+            {
+                size_type sub = child_count(interior, slot);
+                if (n < sub) break;
+                n -= sub;
+            }
+            c = interior->get_childid(slot);
+        }
+
+        typename surface_node::ptr surface = c;
+        if (n >= surface->get_occupants()) return end();
+        return iterator(surface, (unsigned short)n);
+    }
+
+    private:
+
+    /// the key count of a loaded node which may be unknown_count for an
+    /// interior node read from an older page
+    static nst::i64 count_of(typename node::ptr n)
+    {
+        if (n->issurfacenode())
+            return n->get_occupants();
+        typename interior_node::ptr interior = n;
+        return interior->get_total();
+    }
+
+    /// the key count of a child sub tree. unknown counts are resolved by
+    /// counting the child and kept in memory until the node is written
+    size_type child_count(typename interior_node::ptr& interior, int slot)
+    {
+        nst::i64 c = interior->get_count(slot);
+        if (c == unknown_count)
+        {
+            check_low_memory_state();
+            typename node::ptr child = interior->get_childid(slot);
+            if (child->issurfacenode())
+            {
+                c = child->get_occupants();
+            }
+            else
+            {
+                typename interior_node::ptr sub = child;
+                c = 0;
+                for (int k = 0; k <= sub->get_occupants(); ++k)
+                {
+                    c += child_count(sub, k);
+                }
+            }
+            interior->set_count(slot, c);
+        }
+        return (size_type)c;
+    }
+
     public:
     // *** B+ Tree Object Comparison Functions
 
@@ -5227,6 +5854,10 @@ namespace stx
     inline btree(const btree_self &other)
             : root(NULL_REF), headsurface(NULL_REF), last_surface(NULL_REF),
               stats(other.stats),
+              surface_slots(other.surface_slots),
+              interior_slots(other.interior_slots),
+              requested_surface_slots(other.requested_surface_slots),
+              requested_interior_slots(other.requested_interior_slots),
               key_less(other.key_comp()),
               allocator(other.get_allocator())
     {
@@ -5347,6 +5978,204 @@ namespace stx
         }
     }
 
+    /// Load the range [first,last) of value_type pairs sorted by key into an
+    /// empty B+ tree. Surfaces are filled up to the fill factor and linked as
+    /// they are built, the interior levels are built on top of them, so each
+    /// new page is written once. If the tree is not empty or the range is
+    /// found not to be sorted, the remaining pairs are inserted individually.
+    template <typename InputIterator>
+    void bulk_load(InputIterator first, InputIterator last, double fill = 1.0)
+    {
+        unshare();
+        if (root != NULL_REF)
+        {
+            insert(first, last);
+            return;
+        }
+
+        InputIterator iter = first;
+        {
+            bulk_builder builder(*this, fill);
+            for (; iter != last; ++iter)
+            {
+                const pair_type& x = *iter;
+                if (!builder.append(x.first, x.second)) break;
+            }
+            builder.finish();
+        }
+
+        if (selfverify) verify();
+
+        insert(iter, last);
+    }
+
+    private:
+    // *** Private Bulk Loading Functions
+
+    /// Builds the tree bottom-up from pairs appended in key order. Each level
+    /// keeps the children that are not yet placed in a parent. A node is only
+    /// emitted once enough children follow it to make a valid last node, so
+    /// no node is ever below its minimum occupancy.
+    class bulk_builder
+    {
+    private:
+        /// a built sub tree waiting for its parent
+        struct entry
+        {
+            /// the last key in the sub tree which becomes its separator
+            key_type key;
+            typename node::ptr child;
+            nst::i64 count;
+
+            entry(const key_type& key, const typename node::ptr& child, nst::i64 count)
+                    : key(key), child(child), count(count)
+            {
+            }
+        };
+
+        typedef std::vector<pair_type> _Pairs;
+        typedef std::vector<entry> _Entries;
+        typedef std::vector<_Entries> _Levels;
+
+        btree& tree;
+
+        /// keys placed in each surface
+        size_t surface_fill;
+
+        /// children placed in each interior node
+        size_t interior_fill;
+
+        /// pairs not yet placed in a surface
+        _Pairs pairs;
+
+        /// children not yet placed in an interior node, per level
+        _Levels levels;
+
+        /// the last surface emitted
+        typename surface_node::ptr preceding;
+
+        /// the last key appended
+        key_type prior;
+
+        size_type added;
+
+        void push(size_t at, const entry& e)
+        {
+            if (levels.size() <= at) levels.resize(at + 1);
+            levels[at].push_back(e);
+            if (levels[at].size() >= interior_fill + tree.interior_slots / 2 + 1)
+            {
+                emit_interior(at, interior_fill);
+            }
+        }
+
+        void emit_surface(size_t n)
+        {
+            typename surface_node::ptr surface = tree.allocate_surface();
+            surface.change_before();
+            surface->set_occupants(n);
+            for (size_t at = 0; at < n; ++at)
+            {
+                surface->set_kv(at, pairs[at].first, pairs[at].second);
+            }
+
+            if (preceding == NULL_REF)
+            {
+                tree.headsurface = surface;
+            }
+            else
+            {
+                preceding.change_before();
+                preceding->set_next(surface);
+                surface->preceding = preceding;
+                preceding.next_check();
+            }
+            surface.next_check();
+            tree.last_surface = surface;
+            tree.stats.last_surface_size = n;
+            tree.stats.tree_size += n;
+            preceding = surface;
+
+            entry e(pairs[n - 1].first, surface, n);
+            pairs.erase(pairs.begin(), pairs.begin() + n);
+            push(0, e);
+
+            tree.check_low_memory_state();
+        }
+
+        /// emit an interior node from the first n children at level at
+        void emit_interior(size_t at, size_t n)
+        {
+            _Entries& children = levels[at];
+            typename interior_node::ptr interior = tree.allocate_interior(at + 1);
+            interior.change_before();
+            interior->set_occupants(n - 1);
+            for (size_t slot = 0; slot < n; ++slot)
+            {
+                if (slot + 1 < n)
+                    interior->set_key(slot, children[slot].key);
+                interior->set_childid(slot, children[slot].child);
+                interior->set_count(slot, children[slot].count);
+            }
+
+            entry e(children[n - 1].key, interior, interior->get_total());
+            children.erase(children.begin(), children.begin() + n);
+            push(at + 1, e);
+        }
+
+    public:
+        bulk_builder(btree& tree, double fill)
+                : tree(tree), prior(key_type()), added(0)
+        {
+            size_t surfaces = tree.surface_slots, interiors = tree.interior_slots;
+            surface_fill = std::max<size_t>(surfaces / 2, std::min<size_t>(surfaces, (size_t)(fill * surfaces)));
+            surface_fill = std::max<size_t>(surface_fill, 1);
+            interior_fill = std::max<size_t>(interiors / 2 + 1, std::min<size_t>(interiors + 1, (size_t)(fill * (interiors + 1))));
+            preceding.set_context(&tree);
+        }
+
+        /// returns false without adding the pair if it is out of order
+        bool append(const key_type& key, const data_type& value)
+        {
+            if (added > 0 && (allow_duplicates ? tree.key_less(key, prior) : !tree.key_less(prior, key)))
+                return false;
+
+            pairs.push_back(pair_type(key, value));
+            prior = key;
+            ++added;
+            if (pairs.size() >= surface_fill + tree.surface_slots / 2)
+            {
+                emit_surface(surface_fill);
+            }
+            return true;
+        }
+
+        /// emits the remaining pairs and children, splitting the last node of
+        /// a level in two if it would overflow, and sets the root
+        void finish()
+        {
+            if (added == 0) return;
+
+            if (pairs.size() > tree.surface_slots)
+                emit_surface(pairs.size() / 2);
+            if (!pairs.empty())
+                emit_surface(pairs.size());
+
+            for (size_t at = 0; at < levels.size(); ++at)
+            {
+                if (at + 1 == levels.size() && levels[at].size() == 1)
+                {
+                    tree.root = levels[at][0].child;
+                    break;
+                }
+                if (levels[at].size() > tree.interior_slots + 1u)
+                    emit_interior(at, levels[at].size() / 2);
+                emit_interior(at, levels[at].size());
+            }
+            levels.clear();
+        }
+    };
+
     private:
     // *** Private Insertion Functions
 
@@ -5377,6 +6206,8 @@ namespace stx
 
             newroot->set_childid(0, root);
             newroot->set_childid(1, newchild);
+            newroot->set_count(0, count_of(root));
+            newroot->set_count(1, count_of(newchild));
 
             newroot->set_occupants(1);
             newroot.change();
@@ -5427,6 +6258,13 @@ namespace stx
             std::pair<iterator, bool> r = insert_descend(interior->get_childid(at), interior.get_where(), at,
                                                          key, value, &newkey, newchild);
 
+            if (r.second)
+            {
+                /// the child may also have been split, its count is taken after the split
+                interior.change_before();
+                interior->set_count(at, count_of(interior->get_childid(at)));
+            }
+
             if (newchild != NULL_REF)
             {
                 BTREE_PRINT("btree::insert_descend newchild with key " << newkey << " node " << newchild << " at at " << at << std::endl);
@@ -5464,10 +6302,12 @@ namespace stx
                         // move the split key and it's datum into the left node
                         interior->set_key(interior->get_occupants(), *splitkey);
                         interior->set_childid(interior->get_occupants() + 1, splitinterior->get_childid(0));
+                        interior->set_count(interior->get_occupants() + 1, splitinterior->get_count(0));
                         interior->inc_occupants();
 
                         // set new split key and move corresponding datum into right node
                         splitinterior->set_childid(0, newchild);
+                        splitinterior->set_count(0, count_of(newchild));
 
                         *splitkey = newkey;
 
@@ -5495,11 +6335,13 @@ namespace stx
                 {
                     ref->set_key(i, ref->get_key(i - 1));
                     ref->set_childid(i + 1, ref->get_childid(i));
+                    ref->set_count(i + 1, ref->get_count(i));
                     i--;
                 }
 
                 interior->set_key(at ,newkey);
                 interior->set_childid(at + 1, newchild);
+                interior->set_count(at + 1, count_of(newchild));
 
                 interior->inc_occupants();
             }
@@ -5665,9 +6507,11 @@ namespace stx
             unsigned int ni = slot - (mid + 1);
             newinterior->set_key(ni, interior->get_key(slot));
             newinterior->set_childid(ni, interior->get_childid(slot));
+            newinterior->set_count(ni, interior->get_count(slot));
             interior->get_childid(slot).discard(*this);
         }
         newinterior->set_childid(newinterior->get_occupants(), interior->get_childid(interior->get_occupants()));
+        newinterior->set_count(newinterior->get_occupants(), interior->get_count(interior->get_occupants()));
         /// TODO: BUG: this discard causes an invalid page save
         interior->get_childid(interior->get_occupants()).discard(*this);
 
@@ -5806,6 +6650,75 @@ namespace stx
         if (selfverify) verify();
     }
 
+    /// Erases all the key/data pairs with keys in [lower, upper) and returns
+    /// how many were erased. The sub trees between the surfaces holding
+    /// lower and upper are dropped from their parents whole, using their
+    /// counts, and the surface chain is joined across them. Only the nodes
+    /// on the paths to lower and upper are changed and rebalanced, so the
+    /// cost does not depend on the number of surfaces in the range. Like a
+    /// merged surface the pages of a dropped sub tree keep their addresses.
+    size_type erase_range(const key_type &lower, const key_type &upper)
+    {
+        BTREE_PRINT("btree::erase_range(" << lower << "," << upper << ") on btree size " << size() << std::endl);
+
+        unshare();
+
+        if (selfverify) verify();
+
+        if (root == NULL_REF || !key_less(lower, upper)) return 0;
+
+        size_type erased = 0;
+        typename surface_node::ptr first, last;
+        erase_range_descend(root, lower, upper, true, true, first, last, erased);
+
+        if (first != last)
+        {
+            // join the surfaces on either side of the dropped sub trees
+            first.change_before();
+            first->set_next(last);
+            first->change_next();
+            first->set_next_preceding(first);
+            first.next_check();
+            last.next_check();
+        }
+
+        stats.tree_size -= erased;
+
+        // a boundary node only finds a sibling to balance with once its
+        // parent has more than one child, which may take another pass
+        bool again = true;
+        while (again && root != NULL_REF)
+        {
+            again = false;
+            if (!root->issurfacenode())
+            {
+                typename interior_node::ptr top = root;
+                again = erase_range_fix(top, lower);
+            }
+            erase_range_trim();
+            if (root != NULL_REF && !root->issurfacenode())
+            {
+                typename interior_node::ptr top = root;
+                again = erase_range_fix(top, upper) || again;
+            }
+            erase_range_trim();
+        }
+
+        if (root != NULL_REF)
+        {
+            key_type lastkey;
+            erase_range_keys(root, lower, lastkey);
+            erase_range_keys(root, upper, lastkey);
+        }
+
+#ifdef BTREE_DEBUG
+        if (debug) print(std::cout);
+#endif
+        if (selfverify) verify();
+
+        return erased;
+    }
+
 #ifdef BTREE_TODO
     /// Erase all key/data pairs in the range [first,last). This function is
 		/// currently not implemented by the B+ Tree.
@@ -5818,6 +6731,242 @@ namespace stx
     private:
     // *** Private Erase Functions
 
+    /// Erases the keys in [lower, upper) below curr without rebalancing.
+    /// Children of an interior node that are wholly in the range are dropped,
+    /// the boundary children are descended into. An interior node always
+    /// keeps the child on its boundary path, a surface may become empty.
+    /// first and last are set to the surfaces on the lower and upper paths.
+    void erase_range_descend
+            (typename node::ptr curr,
+             const key_type& lower, const key_type& upper,
+             bool lowerpath, bool upperpath,
+             typename surface_node::ptr& first, typename surface_node::ptr& last,
+             size_type& erased)
+    {
+        if (curr->issurfacenode())
+        {
+            typename surface_node::ptr surface = curr;
+
+            int from = find_lower(surface, lower);
+            int to = find_lower(surface, upper);
+            if (from < to)
+            {
+                surface.change_before();
+                surface->erase_run(from, to);
+                erased += to - from;
+                surface.next_check();
+            }
+            if (lowerpath) first = surface;
+            if (upperpath) last = surface;
+            return;
+        }
+
+        typename interior_node::ptr interior = curr;
+        int occupants = interior->get_occupants();
+
+        // the children on the lower and upper paths, a node on only one path
+        // has every key on the other side of it in range
+        int lo = lowerpath ? find_lower(interior, lower) : -1;
+        int hi = upperpath ? find_lower(interior, upper) : occupants + 1;
+
+        if (lo == hi)
+        {
+            erase_range_descend(interior->get_childid(lo), lower, upper, true, true, first, last, erased);
+        }
+        else
+        {
+            if (lowerpath)
+                erase_range_descend(interior->get_childid(lo), lower, upper, true, false, first, last, erased);
+            if (upperpath)
+                erase_range_descend(interior->get_childid(hi), lower, upper, false, true, first, last, erased);
+        }
+
+        // the children in [drop, keep) are wholly in the range
+        int drop = lo + 1;
+        int keep = hi;
+
+        interior.change_before();
+        if (drop < keep)
+        {
+            for (int slot = drop; slot < keep; ++slot)
+            {
+                erased += child_count(interior, slot);
+            }
+
+            // the key of a dropped child goes with it, unless the last child
+            // is dropped and the key before it becomes the bound of the node
+            int removed = keep - drop;
+            int keyat = keep <= occupants ? drop : drop - 1;
+            for (int i = keyat; i + removed < occupants; ++i)
+            {
+                interior->set_key(i, interior->get_key(i + removed));
+            }
+            for (int i = drop; i + removed <= occupants; ++i)
+            {
+                interior->set_childid(i, interior->get_childid(i + removed));
+                interior->set_count(i, interior->get_count(i + removed));
+            }
+            interior->set_occupants(occupants - removed);
+            interior->clear_references();
+        }
+
+        if (lowerpath)
+            interior->set_count(lo, count_of(interior->get_childid(lo)));
+        if (upperpath && lo != hi)
+            interior->set_count(lo + 1, count_of(interior->get_childid(lo + 1)));
+    }
+
+    /// Fixes the children on the path of key under interior that are below
+    /// their minimum, bottom-up, by merging or balancing each with a sibling.
+    /// Returns true if a child could not be fixed because it has no sibling.
+    bool erase_range_fix(typename interior_node::ptr interior, const key_type& key)
+    {
+        int slot = find_lower(interior, key);
+        typename node::ptr child = interior->get_childid(slot);
+
+        bool again = false;
+        if (!child->issurfacenode())
+        {
+            typename interior_node::ptr sub = child;
+            again = erase_range_fix(sub, key);
+        }
+
+        bool underflow = child->issurfacenode()
+                         ? typename surface_node::ptr(child)->isunderflow()
+                         : typename interior_node::ptr(child)->isunderflow();
+        if (!underflow)
+            return again;
+        if (interior->get_occupants() == 0)
+            return true;
+
+        interior.change_before();
+
+        int left = slot < interior->get_occupants() ? slot : slot - 1;
+
+        if (child->issurfacenode())
+        {
+            typename surface_node::ptr leftsurface = interior->get_childid(left);
+            typename surface_node::ptr rightsurface = interior->get_childid(left + 1);
+
+            if (leftsurface->get_occupants() + rightsurface->get_occupants() < surface_slots)
+            {
+                merge_leaves(leftsurface, rightsurface, interior);
+                erase_range_merged(interior, left + 1);
+            }
+            else if (leftsurface->get_occupants() < rightsurface->get_occupants())
+            {
+                shift_left_surface(leftsurface, rightsurface, interior, left);
+            }
+            else
+            {
+                shift_right_surface(leftsurface, rightsurface, interior, left);
+            }
+        }
+        else
+        {
+            typename interior_node::ptr leftinterior = interior->get_childid(left);
+            typename interior_node::ptr rightinterior = interior->get_childid(left + 1);
+
+            if (leftinterior->get_occupants() + rightinterior->get_occupants() < interior_slots)
+            {
+                merge_interior(leftinterior, rightinterior, interior, left);
+                erase_range_merged(interior, left + 1);
+            }
+            else if (leftinterior->get_occupants() < rightinterior->get_occupants())
+            {
+                shift_left_interior(leftinterior, rightinterior, interior, left);
+            }
+            else
+            {
+                shift_right_interior(leftinterior, rightinterior, interior, left);
+            }
+        }
+
+        interior->set_count(left, count_of(interior->get_childid(left)));
+        if (left < interior->get_occupants())
+            interior->set_count(left + 1, count_of(interior->get_childid(left + 1)));
+
+        return again;
+    }
+
+    /// Removes the child at slot of interior that was merged into the child
+    /// before it, like the btree_fixmerge case of erase_one_descend
+    void erase_range_merged(typename interior_node::ptr interior, int slot)
+    {
+        BTREE_ASSERT(interior->get_childid(slot)->get_occupants() == 0);
+
+        free_node(interior->get_childid(slot));
+
+        for (int i = slot; i < interior->get_occupants(); i++)
+        {
+            interior->set_key(i - 1, interior->get_key(i));
+            interior->set_childid(i, interior->get_childid(i + 1));
+            interior->set_count(i, interior->get_count(i + 1));
+        }
+        interior->dec_occupants();
+        interior->clear_references();
+
+        if (interior->level == 1 && slot - 1 < interior->get_occupants())
+        {
+            typename surface_node::ptr child = interior->get_childid(slot - 1);
+            if (child->get_occupants() > 0)
+                interior->set_key(slot - 1, child->get_key(child->get_occupants() - 1));
+        }
+    }
+
+    /// Sets the keys on the path of key below curr to the last keys of their
+    /// children, which is left larger for the children a range was erased
+    /// from. Returns true with the last key of curr if the path ends in it.
+    bool erase_range_keys(typename node::ptr curr, const key_type& key, key_type& lastkey)
+    {
+        if (curr->issurfacenode())
+        {
+            if (curr->get_occupants() == 0) return false;
+            typename surface_node::ptr surface = curr;
+            lastkey = surface->get_key(surface->get_occupants() - 1);
+            return true;
+        }
+
+        typename interior_node::ptr interior = curr;
+        int slot = find_lower(interior, key);
+        key_type sublast;
+        if (!erase_range_keys(interior->get_childid(slot), key, sublast)) return false;
+
+        if (slot == interior->get_occupants())
+        {
+            lastkey = sublast;
+            return true;
+        }
+        if (!key_equal(interior->get_key(slot), sublast))
+        {
+            interior.change_before();
+            interior->set_key(slot, sublast);
+        }
+        return false;
+    }
+
+    /// Replaces an interior root with a single child by that child and
+    /// empties the tree if the root is an empty surface
+    void erase_range_trim()
+    {
+        while (root != NULL_REF && !root->issurfacenode() && root->get_occupants() == 0)
+        {
+            typename interior_node::ptr interior = root;
+            interior.change_before();
+            root = interior->get_childid(0);
+
+            interior->set_occupants(0);
+            free_node(interior);
+        }
+        if (root != NULL_REF && root->issurfacenode() && root->get_occupants() == 0)
+        {
+            free_node(root.rget(), root.get_where());
+
+            root = NULL_REF;
+            headsurface = last_surface = NULL_REF;
+        }
+    }
+
     /** @brief Erase one (the first) key/data pair in the B+ tree matching key.
 		*
 		* Descends down the tree in search of key. During the descent the parent,
@@ -6007,6 +7156,10 @@ namespace stx
                 return result;
             }
 
+            /// siblings changed by a shift have already been counted by the shift
+            interior.change_before();
+            interior->set_count(slot, count_of(interior->get_childid(slot)));
+
             if (result.has(btree_update_lastkey))
             {
                 if (parent != NULL_REF
@@ -6042,8 +7195,11 @@ namespace stx
                 {
                     interior->set_key(i - 1, interior->get_key(i));
                     interior->set_childid(i, interior->get_childid(i + 1));
+                    interior->set_count(i, interior->get_count(i + 1));
                 }
                 interior->dec_occupants();
+                /// the merged node is always the left one
+                interior->set_count(slot - 1, count_of(interior->get_childid(slot - 1)));
 
                 if (interior->level == 1)
                 {
@@ -6320,6 +7476,8 @@ namespace stx
             if (slot > interior->get_occupants())
                 return btree_not_found;
 
+            interior->set_count(slot, count_of(interior->get_childid(slot)));
+
             result_t myres = btree_ok;
 
             if (result.has(btree_update_lastkey))
@@ -6355,8 +7513,10 @@ namespace stx
                 {
                     interior->keys()[i - 1] = interior->keys()[i];
                     interior->set_childid(i, interior->get_childid(i + 1));
+                    interior->set_count(i, interior->get_count(i + 1));
                 }
                 interior->dec_occupants();
+                interior->set_count(slot - 1, count_of(interior->get_childid(slot - 1)));
 
                 if (interior->level == 1)
                 {
@@ -6454,7 +7614,7 @@ namespace stx
 
         for (unsigned int i = 0; i < right->get_occupants(); i++)
         {
-            left->get_key(left->get_occupants() + i) = right->get_key(i);
+            left->set_key(left->get_occupants() + i, right->get_key(i));
             left->get_value(left->get_occupants() + i) = right->get_value(i);
         }
         left->set_occupants(left->get_occupants() + right->get_occupants());
@@ -6516,10 +7676,12 @@ namespace stx
         {
             left->set_key(left->get_occupants() + i, right->get_key(i));
             left->set_childid(left->get_occupants() + i, right->get_childid(i));
+            left->set_count(left->get_occupants() + i, right->get_count(i));
         }
         left->set_occupants(left->get_occupants() + right->get_occupants());
 
         left->set_childid(left->get_occupants() ,right->get_childid(right->get_occupants()));
+        left->set_count(left->get_occupants(), right->get_count(right->get_occupants()));
 
         right->set_occupants(0);
         left.next_check();
@@ -6561,7 +7723,7 @@ namespace stx
         // copy the first items from the right node to the last slot in the left node.
         for (unsigned int i = 0; i < shiftnum; i++)
         {
-            left->get_key(left->get_occupants() + i) = right->get_key(i);
+            left->set_key(left->get_occupants() + i, right->get_key(i));
             left->get_value(left->get_occupants() + i) = right->get_value(i);
         }
         left->set_occupants(left->get_occupants() + shiftnum);
@@ -6571,11 +7733,13 @@ namespace stx
         right->set_occupants(right->get_occupants() - shiftnum);
         for (int i = 0; i < right->get_occupants(); i++)
         {
-            right->get_key(i) = right->get_key(i + shiftnum);
+            right->set_key(i, right->get_key(i + shiftnum));
             right->get_value(i) = right->get_value(i + shiftnum);
         }
         left.next_check();
         right.next_check();
+        parent->set_count(parentslot, left->get_occupants());
+        parent->set_count(parentslot + 1, right->get_occupants());
         // fixup parent
         if (parentslot < parent->get_occupants())
         {
@@ -6640,6 +7804,7 @@ namespace stx
         {
             left->set_key(left->get_occupants() + i, right->get_key(i));
             left->set_childid(left->get_occupants() + i, right->get_childid(i));
+            left->set_count(left->get_occupants() + i, right->get_count(i));
         }
         left->set_occupants(left->get_occupants() + shiftnum - 1);
 
@@ -6647,6 +7812,7 @@ namespace stx
         parent->set_key(parentslot, right->get_key(shiftnum - 1));
         // last pointer in left
         left->set_childid(left->get_occupants(), right->get_childid(shiftnum - 1));
+        left->set_count(left->get_occupants(), right->get_count(shiftnum - 1));
 
         // shift all slots in the right node
 
@@ -6655,8 +7821,12 @@ namespace stx
         {
             right->set_key(i, right->get_key(i + shiftnum));
             right->set_childid(i, right->get_childid(i + shiftnum));
+            right->set_count(i, right->get_count(i + shiftnum));
         }
         right->set_childid(right->get_occupants(), right->get_childid(right->get_occupants() + shiftnum));
+        right->set_count(right->get_occupants(), right->get_count(right->get_occupants() + shiftnum));
+        parent->set_count(parentslot, left->get_total());
+        parent->set_count(parentslot + 1, right->get_total());
         right.next_check();
         left.next_check();
     }
@@ -6709,20 +7879,22 @@ namespace stx
 
         for (int i = right->get_occupants() - 1; i >= 0; i--)
         {
-            right->get_key(i + shiftnum) = right->get_key(i);
-            right->get_key(i + shiftnum) = right->get_key(i);
+            right->set_key(i + shiftnum, right->get_key(i));
+            right->get_value(i + shiftnum) = right->get_value(i);
         }
         right->set_occupants(right->get_occupants() + shiftnum);
 
         // copy the last items from the left node to the first slot in the right node.
         for (unsigned int i = 0; i < shiftnum; i++)
         {
-            right->get_key(i) = left->get_key(left->get_occupants() - shiftnum + i);
+            right->set_key(i, left->get_key(left->get_occupants() - shiftnum + i));
             right->get_value(i) = left->get_value(left->get_occupants() - shiftnum + i);
         }
         left->set_occupants(left->get_occupants() - shiftnum);
 
         parent->set_key(parentslot, left->get_key(left->get_occupants() - 1));
+        parent->set_count(parentslot, left->get_occupants());
+        parent->set_count(parentslot + 1, right->get_occupants());
         left.next_check();
         right.next_check();
     }
@@ -6770,28 +7942,34 @@ namespace stx
         BTREE_ASSERT(right->get_occupants() + shiftnum < interiorslotmax);
 
         right->set_childid(right->get_occupants() + shiftnum, right->get_childid(right->get_occupants()));
+        right->set_count(right->get_occupants() + shiftnum, right->get_count(right->get_occupants()));
         for (int i = right->get_occupants() - 1; i >= 0; i--)
         {
             right->set_key(i + shiftnum, right->get_key(i));
             right->set_childid(i + shiftnum, right->get_childid(i));
+            right->set_count(i + shiftnum, right->get_count(i));
         }
         right->set_occupants(right->get_occupants() + shiftnum);
 
         // copy the parent's decision keys and childid to the last new key on the right
         right->set_key(shiftnum - 1, parent->get_key(parentslot));
         right->set_childid(shiftnum - 1, left->get_childid(left->get_occupants()));
+        right->set_count(shiftnum - 1, left->get_count(left->get_occupants()));
 
         // copy the remaining last items from the left node to the first slot in the right node.
         for (unsigned int i = 0; i < shiftnum - 1; i++)
         {
             right->set_key(i, left->get_key(left->get_occupants() - shiftnum + i + 1));
             right->set_childid(i, left->get_childid(left->get_occupants() - shiftnum + i + 1));
+            right->set_count(i, left->get_count(left->get_occupants() - shiftnum + i + 1));
         }
 
         // copy the first to-be-removed key from the left node to the parent's decision slot
         parent->set_key(parentslot, left->get_key(left->get_occupants() - shiftnum));
 
         left->set_occupants(left->get_occupants() - shiftnum);
+        parent->set_count(parentslot, left->get_total());
+        parent->set_count(parentslot + 1, right->get_total());
 
     }
 
@@ -7039,4 +8217,4 @@ namespace stx
 };
 } // namespace stx
 
-#endif // _STX_BTREE_H_
\ No newline at end of file
+#endif // _STX_BTREE_H_
\ No newline at end of file
@@ -101,6 +101,9 @@ public:
     /// Small structure containing statistics about the tree
     typedef typename btree_impl::tree_stats     tree_stats;
 
+    /// Point lookup table used by direct()
+    typedef typename btree_impl::key_cache      key_cache;
+
 public:
     // *** Static Constant Options and Values of the B+ Tree
 
@@ -334,6 +337,30 @@ public:
         return tree.get_stats();
     }
 
+    /// Return the point lookup table with its hit and miss counters
+    inline const key_cache& get_key_cache() const
+    {
+        return tree.get_key_cache();
+    }
+
+    /// The number of slots used in each surface node
+    inline unsigned short get_surface_slots() const
+    {
+        return tree.get_surface_slots();
+    }
+
+    /// The number of slots used in each interior node
+    inline unsigned short get_interior_slots() const
+    {
+        return tree.get_interior_slots();
+    }
+
+    /// Sets the page sizes of a new tree, see btree::set_page_sizes
+    bool set_page_sizes(unsigned short surfaces, unsigned short interiors)
+    {
+        return tree.set_page_sizes(surfaces, interiors);
+    }
+
 public:
     // *** Standard Access Functions Querying the Tree by Descending to a surface
 
@@ -381,6 +408,14 @@ public:
         return tree.find(key);
     }
 
+    /// Looks up a sorted sequence of keys sharing the descent between
+    /// adjacent keys and writes an iterator or end() for each key to out.
+    template <typename _KeyIterator, typename _OutputIterator>
+    void find_many(_KeyIterator first, _KeyIterator last, _OutputIterator out)
+    {
+        tree.find_many(first, last, out);
+    }
+
     /// Tries to locate a key in the B+ tree and returns the number of
     /// identical key entries found. Since this is a unique map, count()
     /// returns either 0 or 1.
@@ -431,6 +466,28 @@ public:
         return tree.equal_range(key);
     }
 
+public:
+    // *** Order Statistics
+
+    /// Returns the number of keys less than key, the position of lower_bound().
+    size_type rank(const key_type& key)
+    {
+        return tree.rank(key);
+    }
+
+    /// Returns the number of keys in the range [lower, upper) without
+    /// iterating over the keys in between.
+    size_type count(const key_type& lower, const key_type& upper)
+    {
+        return tree.count(lower, upper);
+    }
+
+    /// Returns an iterator to the n'th key or end() if there are n or fewer keys.
+    iterator select(size_type n)
+    {
+        return tree.select(n);
+    }
+
 public:
     // *** B+ Tree Object Comparison Functions
 
@@ -566,6 +623,16 @@ public:
         return tree.insert(first, last);
     }
 
+    /// Load the range [first,last) of key/data pairs sorted by key into an
+    /// empty map, building full surfaces and the interior levels bottom-up.
+    /// The fill factor sets how full the new pages are. Falls back to insert
+    /// for a map that is not empty or a range that is not sorted.
+    template <typename InputIterator>
+    inline void bulk_load(InputIterator first, InputIterator last, double fill = 1.0)
+    {
+        return tree.bulk_load(first, last, fill);
+    }
+
 public:
 
 	/// reduce the tree memory use by storing pages to alternate storage
@@ -593,6 +660,13 @@ public:
         return tree.erase(key);
     }
 
+    /// Erases all the key/data pairs with keys in [lower, upper), see
+    /// btree::erase_range
+    size_type erase_range(const key_type &lower, const key_type &upper)
+    {
+        return tree.erase_range(lower, upper);
+    }
+
     /// Erase the key/data pair referenced by the iterator.
     void erase(iterator iter)
     {
@@ -34,6 +34,28 @@ namespace stx{
 			return 0;///(size_t) std::hash<_Ht>()(k); ///
 		};
 	};
+	/// order preserving fixed width key prefix used to narrow node searches
+	/// to integer compares. for any keys a and b sharing an extent e
+	/// prefix(a,e) < prefix(b,e) implies a < b and a < b implies
+	/// prefix(a,e) <= prefix(b,e). it is only used by specializations that
+	/// set used
+	template<typename _Ht>
+	struct btree_prefix{
+		static const bool used = false;
+		/// the extent shared by the sorted keys first and last which all the
+		/// keys between them share as well, zero if nothing is shared
+		storage::u32 shared(const _Ht&, const _Ht&) const{
+			return 0;
+		};
+		/// true if k shares the extent of first
+		bool shares(const _Ht&, const _Ht&, storage::u32) const{
+			return true;
+		};
+		/// the prefix of k after the shared extent
+		storage::u64 operator()(const _Ht&, storage::u32) const{
+			return 0;
+		};
+	};
 	namespace storage{
 
 		namespace allocation{
@@ -188,7 +188,7 @@ namespace stx{
 		/*
 		 * Returns the number of bytes needed to encode "val" in ULEB128 form.
 		 */
-		inline i32 unsigned_size(u32 data)
+		inline i32 unsigned_size(u64 data)
 		{
 			i32 count = 0;
 
@@ -55,6 +55,52 @@ print("original=",inspect(s.data))
 s.data = nil
 
 print("linked=",inspect(s.link))
+print("cleared=",spaces.clear(s.link),inspect(s.link))
+
+s.doc = string.rep("0123456789", 1000)
+local b = spaces.blob(s, "doc")
+local parts = 0
+for part in b:chunks(4096) do
+	parts = parts + 1
+end
+print("blob=",b:size(),b:read(0,5),b:read(9995),parts)
+
+s.events = {}
+s.events[{"user", 42, "ts1"}] = 1
+s.events[{"user", 42, "ts2"}] = 2
+s.events[{"user", 43, "ts1"}] = 3
+for k,v in s.events{"user", 42} do
+	print("composite=",inspect(k),v)
+end
+for k,v in s.events(nil, {"user", 42}, {"user", 43}) do
+	print("composite upper=",inspect(k),v)
+end
+
+spaces.batch(function()
+	s.bulk = {}
+	spaces.set(s.bulk, {a=1, b="two", c={d=3}})
+	spaces.setMany(s.bulk, {"e", "f", "a"}, {5, 6})
+end)
+print("bulk=",inspect(s.bulk))
+
+s.numbers = {}
+for i = 1,100 do s.numbers[i] = i*i end
+for names, values in spaces.range(s.numbers, 10, nil, 16, 5, 40) do
+	print("range=",#names,names[1],values[#values])
+end
+
+for k,v in s.numbers(nil, nil, {reverse=true, limit=3}) do
+	print("newest=",k,v)
+end
+s.numbers[-1] = 1
+for k,v in s.numbers(nil, 2) do
+	print("open=",k,v)
+end
+for k,v in s.numbers(1, 50, {after=45}) do
+	print("after=",k,v)
+end
+
+print("aggregates=",spaces.count(s.numbers, 1, 11),spaces.sum(s.numbers, 1, 11),spaces.minmax(s.numbers, 1, 11),spaces.exists(s.numbers, 200))
 
 --print(inspect(s))
 spaces.rollback()
\ No newline at end of file